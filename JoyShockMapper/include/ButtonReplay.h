@@ -0,0 +1,16 @@
+#pragma once
+
+#include "JoyShockMapper.h"
+
+namespace JSM
+{
+
+// Feed the button state machines with the button changes recorded in a text file, and print every output
+// they produce instead of performing it. Each line of the file is "<ms> <BUTTON> <1|0>": the time since the
+// start of the recording, the button and whether it is now pressed. Lines starting with # are ignored.
+// The buttons are polled every millisecond in simulated time with the current bindings and settings, until
+// they all return to rest. Each output is printed as "<ms> <BUTTON> <action> <key>", so the traces of two
+// builds can be compared line by line.
+bool replayButtons(const string &fileName);
+
+} // namespace JSM
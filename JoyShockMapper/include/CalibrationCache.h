@@ -0,0 +1,53 @@
+#pragma once
+
+#include "JoyShockMapper.h"
+#include <future>
+#include <mutex>
+#include <optional>
+
+namespace JSM
+{
+
+// Remembers the gyro calibration offsets of each physical controller across reconnects.
+// Entries are keyed by the device identifier provided by JslWrapper::GetDeviceIdentifier()
+// and persisted in a small text file in the base JSM config folder.
+class CalibrationCache
+{
+public:
+	struct Offset
+	{
+		float x = 0.f;
+		float y = 0.f;
+		float z = 0.f;
+	};
+
+	// Number of samples a restored offset is worth when handed to the motion engine.
+	// Continuous calibration can still refine it afterwards.
+	static constexpr int RESTORED_WEIGHT = 10;
+
+	CalibrationCache(string_view fileName);
+
+	~CalibrationCache();
+
+	// Read the file on a worker thread if it wasn't already, then call onLoaded from that thread.
+	void loadAsync(function<void()> onLoaded);
+
+	optional<Offset> get(string_view deviceId);
+
+	void set(string_view deviceId, const Offset &offset);
+
+	// Write all entries back to disk if any changed
+	bool save();
+
+private:
+	void load();
+
+	string _path;
+	mutex _lock;
+	map<string, Offset, less<>> _entries;
+	future<void> _loading;
+	bool _loaded = false;
+	bool _dirty = false;
+};
+
+} // namespace JSM
@@ -1,20 +1,23 @@
 #pragma once
 
-#include "pocket_fsm.h"
 #include "JoyShockMapper.h"
 #include "Gamepad.h"
 #include "MotionIf.h"
+#include <array>
+#include <bitset>
 #include <chrono>
+#include <condition_variable>
 #include <deque>
 #include <mutex>
+#include <thread>
 
 // Forward declarations
 class JSMButton;
 class DigitalButton;      // Finite State Machine
-struct DigitalButtonImpl; // Button implementation
-class MapIterator;
+struct DigitalButtonImpl; // Button data shared by all states
+struct ComboPartner;
 
-// The enum values match the concrete class names
+// States of the digital button state machine
 enum class BtnState
 {
 	NoPress,
@@ -56,63 +59,154 @@ struct Released
 // The sync event is created internally
 struct Sync;
 
-// Getter for the button press duration. Pass timestamp of the poll.
-struct GetDuration
+// Keys made active by buttons, in order of activation. Membership tests go through indices
+// instead of scanning the entries.
+class ActiveKeys
 {
-	chrono::steady_clock::time_point in_now;
-	float out_duration;
-};
+public:
+	typedef pair<ButtonID, KeyCode> Entry;
 
-// Setter for the press time
-typedef chrono::steady_clock::time_point SetPressTime;
+	void push(ButtonID id, KeyCode key);
+
+	// Remove all the entries of key. Returns whether there were any.
+	bool erase(KeyCode key);
+
+	// The oldest key made active by button id, if any
+	optional<KeyCode> oldestOf(ButtonID id) const;
+
+	inline bool contains(KeyCode key) const
+	{
+		return _byKey.contains(keyIndex(key));
+	}
+
+	inline bool contains(ButtonID id) const
+	{
+		return _byButton.contains(id);
+	}
+
+	inline bool contains(ButtonID id, KeyCode key) const
+	{
+		return _byEntry.contains({ id, keyIndex(key) });
+	}
+
+	// From oldest to newest
+	inline vector<Entry>::const_iterator begin() const
+	{
+		return _entries.cbegin();
+	}
 
-// A basic digital button state reacts to the following events
-class DigitalButtonState : public pocket_fsm::StatePimplIF<DigitalButtonImpl>
+	inline vector<Entry>::const_iterator end() const
+	{
+		return _entries.cend();
+	}
+
+private:
+	static inline uint32_t keyIndex(KeyCode key)
+	{
+		return uint32_t(key.code) << 16 | key.nameId;
+	}
+
+	vector<Entry> _entries;
+	// Number of entries per key, button and pair of both
+	map<uint32_t, int> _byKey;
+	map<ButtonID, int> _byButton;
+	map<pair<ButtonID, uint32_t>, int> _byEntry;
+};
+
+// The active chords from most recent to oldest, ending with NONE. Membership is a bit test, and the order
+// is kept in a fixed array large enough for every button to be held at once.
+class ChordStack
 {
-	BASE_STATE(DigitalButtonState)
+public:
+	static constexpr size_t CAPACITY = size_t(ButtonID::T25) + 2; // From NONE to the last touch button
 
-	// Display logs on entry for debigging
-	REACT(OnEntry)
-	override;
+	typedef array<ButtonID, CAPACITY>::const_reverse_iterator const_iterator;
 
-	// ignored
-	REACT(OnExit)
-	override { }
+	// Make id the most recent chord, unless it is active already
+	void push(ButtonID id);
 
-	// Adds chord to stack if absent
-	REACT(Pressed);
+	void erase(ButtonID id);
 
-	// Remove chord from stack if present
-	REACT(Released);
+	// Erase all the chords for which pred is true
+	template<typename Pred>
+	void erase_if(Pred pred)
+	{
+		auto last = remove_if(_order.begin(), _order.begin() + _size, [this, &pred](ButtonID id)
+		  {
+			  if (!pred(id))
+				  return false;
+			  _active.reset(index(id));
+			  return true;
+		  });
+		if (size_t newSize = last - _order.begin(); newSize != _size)
+		{
+			_size = newSize;
+			++_version;
+		}
+	}
 
-	// ignored by default
-	REACT(Sync) { }
+	inline bool contains(ButtonID id) const
+	{
+		return index(id) < CAPACITY && _active.test(index(id));
+	}
 
-	// Always assign press time
-	REACT(SetPressTime)
-	final;
+	inline size_t size() const
+	{
+		return _size;
+	}
 
-	// Return press duration
-	REACT(GetDuration)
-	final;
+	// Changes whenever the stack does, so values computed from the active chords can tell whether they still hold
+	inline uint32_t version() const
+	{
+		return _version;
+	}
 
-	// Get matching enum value
-	virtual BtnState getState() const = 0;
+	// From the most recent chord
+	inline const_iterator begin() const
+	{
+		return const_iterator(_order.cbegin() + _size);
+	}
 
-	virtual void swapPimpl(DigitalButtonState& otherState)
+	inline const_iterator end() const
 	{
-		_pimpl.swap(otherState._pimpl);
+		return const_iterator(_order.cbegin());
 	}
 
-	virtual void resetPimpl(DigitalButtonState & otherState)
+private:
+	static inline size_t index(ButtonID id)
 	{
-		_pimpl = otherState._pimpl;
+		return size_t(int(id) + 1);
 	}
+
+	bitset<CAPACITY> _active;
+	array<ButtonID, CAPACITY> _order{}; // Oldest first
+	size_t _size = 0;
+	uint32_t _version = 0;
 };
 
+// Combined effect of the active gyro actions, where the most recent action wins
+struct GyroModifiers
+{
+	optional<bool> blockGyro; // Set by GYRO_ON and GYRO_OFF bindings
+	bool invertX = false;
+	bool invertY = false;
+	bool trackballX = false;
+	bool trackballY = false;
+};
+
+// Getter for the button press duration. Pass timestamp of the poll.
+struct GetDuration
+{
+	chrono::steady_clock::time_point in_now;
+	float out_duration;
+};
+
+// Setter for the press time
+typedef chrono::steady_clock::time_point SetPressTime;
+
 // Feed this state machine with Pressed and Released events and it will sort out
 // what mappings to activate internally
-class DigitalButton : public pocket_fsm::FiniteStateMachine<DigitalButtonState>
+class DigitalButton
 {
 public:
 	// All digital _buttons need a reference to the same instance of the common structure within the same controller.
@@ -120,35 +214,171 @@ public:
 	struct Context
 	{
 		Context(Gamepad::Callback virtualControllerCallback, shared_ptr<MotionIf> mainMotion);
-		deque<pair<ButtonID, KeyCode>> gyroActionQueue; // Queue of gyro control actions currently in effect
-		deque<pair<ButtonID, KeyCode>> activeTogglesQueue;
-		deque<ButtonID> chordStack; // Represents the current active _buttons in order from most recent to latest
+		// Replay recorded input: every output goes to trace instead of the OS, and deadlines are left to the caller
+		Context(function<void(ButtonID, string_view action, string_view key)> trace);
+		~Context();
+		ActiveKeys gyroActions; // Gyro control actions currently in effect
+		ActiveKeys activeToggles;
+		GyroModifiers gyroModifiers; // Summary of gyroActions
+		ChordStack chordStack; // Represents the current active _buttons in order from most recent to latest
 		unique_ptr<Gamepad> _vigemController;
-		function<DigitalButton *(ButtonID)> _getMatchingSimBtn; // A functor to JoyShock::getMatchingSimBtn
-		function<DigitalButton *(ButtonID, optional<MapIterator>&)> _getMatchingDiagBtn; // A functor to JoyShock::getMatchingDiagBtn
+		function<DigitalButton *(ButtonID, ComboPartner &)> _getMatchingSimBtn;           // A functor to JoyShock::getMatchingSimBtn
+		function<DigitalButton *(ButtonID, size_t &, ComboPartner &)> _getMatchingDiagBtn; // A functor to JoyShock::getMatchingDiagBtn
 		function<void(int small, int big)> _rumble;             // A functor to JoyShock::sendRumble
+		function<void(ButtonID, string_view, string_view)> _trace; // Receives the outputs instead of the OS when replaying input
 		mutex callback_lock;                                    // Needs to be in the common struct for both joycons to use the same
 		shared_ptr<MotionIf> rightMainMotion = nullptr;
 		shared_ptr<MotionIf> leftMotion = nullptr;
 		int nn = 0;
+		map<int, function<void(chrono::steady_clock::time_point)>> deadlineHandlers; // JoyShock::fireDeadlines of each handle sharing this context
 
 		void updateChordStack(bool isPressed, ButtonID index);
+
+		// Compute gyroModifiers again. Call whenever gyroActions changes.
+		void updateGyroModifiers();
+
+		// Wake up the deadline thread at the given time. It then calls every deadline handler under the callback lock.
+		void scheduleDeadline(chrono::steady_clock::time_point deadline);
+
+	private:
+		void deadlineLoop();
+
+		mutex _deadlineLock;
+		condition_variable _deadlineChanged;
+		chrono::steady_clock::time_point _nextDeadline = chrono::steady_clock::time_point::max();
+		bool _stopDeadlines = false;
+		thread _deadlineThread;
 	};
 
 	DigitalButton(shared_ptr<DigitalButton::Context> _context, JSMButton &mapping);
+	DigitalButton(DigitalButton &&other) noexcept;
+	~DigitalButton();
 
 	const ButtonID _id;
 
+	void sendEvent(const Pressed &e);
+
+	void sendEvent(const Released &e);
+
+	// Always assign press time
+	void sendEvent(SetPressTime e);
+
+	// Return press duration
+	GetDuration &sendEvent(GetDuration &e);
+
+	// Send the last event again if the state had a deadline that is now past. Hold, turbo, tap and
+	// double press then happen on time instead of on the next poll. pressedNow is the physical state
+	// of the button when it can be read between polls: once it no longer matches the last event, only
+	// time passes and the next poll delivers the change.
+	void fireDeadline(chrono::steady_clock::time_point now, optional<bool> pressedNow);
+
+	// Next time at which the state would progress without any change of input
+	optional<chrono::steady_clock::time_point> getDeadline() const
+	{
+		return _deadline;
+	}
+
 	// Get the enum identifier of the current state
 	BtnState getState() const
 	{
-		return getCurrentState()->getState();
+		return _state;
 	}
 
-	void swapState(DigitalButton& otherBtn)
+	// A released button in this state has nothing to process: Released events can be skipped
+	bool isIdle() const;
+
+	// The bindings of this button
+	const JSMButton &getMapping() const;
+
+	void swapState(DigitalButton &otherBtn, chrono::steady_clock::time_point now)
 	{
-		// Swap just the state, but leave the pimpls in their respective button
-		_currentState->swapPimpl(*otherBtn._currentState);
-		_currentState.swap(otherBtn._currentState);
+		// Swap just the state, but leave the data in their respective button
+		swap(_state, otherBtn._state);
+		swap(_activeState, otherBtn._activeState);
+		updateDeadline(now);
+		otherBtn.updateDeadline(now);
 	}
+
+private:
+	// Nested state of the states in which a mapping is active
+	enum class ActiveState : uint8_t
+	{
+		StartPress,
+		HoldPress,
+	};
+
+	// What each state does with the events. The states that have no reaction of their own
+	// use the base reactions, which only keep the chord stack up to date.
+	struct StateHandlers
+	{
+		void (DigitalButton::*onEntry)();
+		void (DigitalButton::*onExit)();
+		void (DigitalButton::*pressed)(const Pressed &);
+		void (DigitalButton::*released)(const Released &);
+		void (DigitalButton::*sync)(Sync &);
+	};
+	static const array<StateHandlers, size_t(BtnState::INVALID)> STATE_HANDLERS;
+
+	// Sync events are sent by other _buttons of the same controller
+	Sync &sendEvent(Sync &e);
+
+	// The transition happens once the current reaction is complete
+	void changeState(BtnState nextState)
+	{
+		_nextState = nextState;
+	}
+	// Also refreshes the deadline, which any transition can change
+	void commitState(chrono::steady_clock::time_point now);
+	void updateDeadline(chrono::steady_clock::time_point now);
+
+	void ignore() { }
+	void ignoreSync(Sync &e) { }
+	void basePressed(const Pressed &e);
+	void baseReleased(const Released &e);
+	void startDiagonalPress(const Pressed &e);
+
+	void activeEntry();
+	void activePressed(const Pressed &e);
+	void activeReleased(const Released &e);
+	void activeSync(Sync &e);
+	void startPressEntry();
+	void startPressPressed(const Pressed &e);
+	void startPressReleased(const Released &e);
+	void holdPressEntry();
+	void holdPressPressed(const Pressed &e);
+	void holdPressReleased(const Released &e);
+	void activeMappingReleased(const Released &e);
+
+	void noPressPressed(const Pressed &e);
+	void tapPressEntry();
+	void tapPressExit();
+	void tapPressPressed(const Pressed &e);
+	void tapPressReleased(const Released &e);
+	void waitSimPressed(const Pressed &e);
+	void waitSimReleased(const Released &e);
+	void waitSimSync(Sync &e);
+	void simPressSlavePressed(const Pressed &e);
+	void simPressSlaveReleased(const Released &e);
+	void simReleaseReleased(const Released &e);
+	void simReleaseSync(Sync &e);
+	void diagPressSlavePressed(const Pressed &e);
+	void diagPressSlaveReleased(const Released &e);
+	void dblPressStartReleased(const Released &e);
+	void dblPressNoPressPressed(const Pressed &e);
+	void dblPressNoPressReleased(const Released &e);
+	void dblPressNoPressTapPressed(const Pressed &e);
+	void dblPressNoPressTapReleased(const Released &e);
+	void dblPressNoPressHoldPressed(const Pressed &e);
+	void dblPressNoPressHoldReleased(const Released &e);
+	void dblPressPressEntry();
+	void instReleasePressed(const Pressed &e);
+	void instReleaseReleased(const Released &e);
+
+	BtnState _state = BtnState::NoPress;
+	BtnState _nextState = BtnState::INVALID;
+	ActiveState _activeState = ActiveState::StartPress;
+	optional<chrono::steady_clock::time_point> _deadline;
+	Released _lastEvent; // Settings of the last event, with its type below
+	bool _lastPressed = false;
+	unique_ptr<DigitalButtonImpl> _impl;
 };
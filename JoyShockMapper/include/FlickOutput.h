@@ -0,0 +1,44 @@
+#pragma once
+
+#include "InputHelpers.h"
+#include <chrono>
+#include <mutex>
+
+namespace JSM
+{
+
+// Streams the mouse rotation of flick stick on its own timer, so that the animation isn't
+// quantized to the controller poll rate. Each flick is handed over whole when it starts and
+// the thread emits the eased progress since its last tick, until the flick is complete.
+class FlickOutput : public PollingThread
+{
+public:
+	FlickOutput(float rate, bool start);
+	virtual ~FlickOutput();
+
+	// Rate at which the rotation is emitted, in Hz. Capped by the 1ms period of the thread.
+	void setRate(float rate);
+
+	// Animate a flick of distance mouse units over duration seconds. A new flick from the same
+	// owner replaces the one in progress, exactly like it does when flicks are processed per poll.
+	void start(const void *owner, chrono::steady_clock::time_point started, float duration, float distance);
+
+private:
+	struct Flick
+	{
+		const void *owner;
+		chrono::steady_clock::time_point started;
+		float duration;
+		float distance;
+		float shapedDone;
+	};
+
+	bool FlickOutputPoll(void *param);
+
+	mutex _lock;
+	vector<Flick> _flicks;
+	atomic<float> _period;
+	chrono::steady_clock::time_point _lastOutput;
+};
+
+} // namespace JSM
@@ -47,6 +47,10 @@ void moveMouse(float x, float y);
 
 void setMouseNorm(float x, float y);
 
+// Scroll the mouse wheel by a number of notches, positive is up. Fractions are sent as high resolution
+// wheel movement and whatever the system can't represent is carried over to the next call.
+void scrollMouse(float notches);
+
 // delta time will apply to shaped movement, but the extra (velocity parameters after deltaTime) is
 // applied as given
 inline void shapedSensitivityMoveMouse(float x, float y, float deltaTime, float extraVelocityX, float extraVelocityY)
@@ -93,15 +97,7 @@ public:
 
 	virtual ~PollingThread()
 	{
-		if (_continue)
-		{
-			Stop();
-		}
-		if (_thread)
-		{
-			_thread->join();
-			_thread.reset();
-		}
+		Join();
 		// Let poll function cleanup
 	}
 
@@ -136,6 +132,18 @@ public:
 		return _thread && _continue;
 	}
 
+	// Stop and wait for the loop to exit. Derived classes whose loop uses their own members
+	// call this in their destructor, before those members are destroyed.
+	void Join()
+	{
+		Stop();
+		if (_thread)
+		{
+			_thread->join();
+			_thread.reset();
+		}
+	}
+
 	const char *_label;
 
 private:
@@ -3,6 +3,7 @@
 #include "JoyShockMapper.h"
 #include "Mapping.h"
 #include <sstream>
+#include <atomic>
 
 // Global ID generator
 static unsigned int _delegateID = 1;
@@ -272,35 +273,41 @@ public:
 // A combo map is an item of _simMappings below. It holds an alternative variable when ButtonID is pressed.
 typedef pair<const ButtonID, JSMVariable<Mapping>> ComboMap;
 
-class MapIterator
+// A button with which another one has a sim or diagonal press, and the binding of the combination
+struct ComboPartner
 {
-	const map<ButtonID, JSMVariable<Mapping>> *_mapping;
-	map<ButtonID, JSMVariable<Mapping>>::const_iterator _iter;
+	ButtonID id = ButtonID::NONE;
+	const JSMVariable<Mapping> *mapping = nullptr;
+};
+
+// A list of combo partners that is only ever replaced whole. The poll threads keep a reference
+// to the list they scan while the console thread publishes a rebuilt one.
+class ComboPartners
+{
+	atomic<shared_ptr<const vector<ComboPartner>>> _list;
 
 public:
-	MapIterator(const map<ButtonID, JSMVariable<Mapping>> &mapping)
-	  : _mapping(&mapping)
-	  , _iter(_mapping->begin())
+	ComboPartners()
+	  : _list(make_shared<const vector<ComboPartner>>())
 	{
 	}
 
-	operator bool() const
+	ComboPartners(const ComboPartners &other)
+	  : _list(other._list.load())
 	{
-		return _iter != _mapping->cend();
 	}
 
-	void operator++()
+	inline shared_ptr<const vector<ComboPartner>> get() const
 	{
-		_iter++;
+		return _list.load();
 	}
 
-	const ComboMap *operator->() const
+	inline void publish(vector<ComboPartner> &&list)
 	{
-		return &*_iter;
+		_list.store(make_shared<const vector<ComboPartner>>(move(list)));
 	}
 };
 
-
 // Button mappings includes not only chorded mappings, but also simultaneous press mappings
 class JSMButton : public ChordedVariable<Mapping>
 {
@@ -315,6 +322,33 @@ protected:
 	// Store listener IDs for its sim presses. This is required for Cross updates
 	map<ButtonID, unsigned int> _mapping;
 
+	// Flat copies of the sim and diag mappings above, scanned on every sim or diagonal press
+	ComboPartners _simPartners;
+	ComboPartners _diagPartners;
+
+	// Rebuild the partner lists whenever a sim or diag mapping is added or removed
+	void updatePartners()
+	{
+		vector<ComboPartner> simPartners;
+		for (auto &[id, var] : _simMappings)
+		{
+			if (id != _id) // That's a double press
+			{
+				simPartners.push_back({ id, &var });
+			}
+		}
+		_simPartners.publish(move(simPartners));
+		vector<ComboPartner> diagPartners;
+		for (auto &[id, var] : _diagMappings)
+		{
+			if (id != _id)
+			{
+				diagPartners.push_back({ id, &var });
+			}
+		}
+		_diagPartners.publish(move(diagPartners));
+	}
+
 public:
 	JSMButton(ButtonID id, Mapping def)
 	  : ChordedVariable(def)
@@ -336,16 +370,16 @@ public:
 		}
 	}
 
-	// Obtain the Variable for a sim press if any.
-	MapIterator getSimMapIter() const
+	// The buttons with which this one has a sim press
+	inline shared_ptr<const vector<ComboPartner>> getSimPartners() const
 	{
-		return MapIterator(_simMappings);
+		return _simPartners.get();
 	}
 
-	// Obtain the Variable for a sim press if any.
-	MapIterator getDiagMapIter() const
+	// The buttons with which this one has a diagonal press
+	inline shared_ptr<const vector<ComboPartner>> getDiagPartners() const
 	{
-		return MapIterator(_diagMappings);
+		return _diagPartners.get();
 	}
 
 	// Double Press mappings are stored in the chorded variables
@@ -389,34 +423,6 @@ public:
 			return string();
 	}
 
-	// Returns the sim press name of itself with simBtn.
-	string getSimPressName(ButtonID simBtn) const
-	{
-		if (simBtn == _id)
-		{
-			// It's actually a double press, not a sim press
-			return getName(simBtn);
-		}
-		if (simBtn > ButtonID::NONE)
-		{
-			stringstream ss;
-			ss << simBtn << '+' << _id;
-			return ss.str();
-		}
-		return string();
-	}
-
-	string getDiagPressName(ButtonID simBtn) const
-	{
-		if (simBtn > ButtonID::NONE)
-		{
-			stringstream ss;
-			ss << simBtn << '*' << _id;
-			return ss.str();
-		}
-		return string();
-	}
-
 	// Resetting a button also clears all assigned sim presses
 	virtual JSMButton *reset() override
 	{
@@ -428,6 +434,7 @@ public:
 		}
 		_simMappings.clear();
 		_diagMappings.clear();
+		updatePartners();
 		return this;
 	}
 
@@ -443,6 +450,7 @@ public:
 			_simMappings.emplace(chord, var);
 			_mapping[chord] = _simMappings[chord].addOnChangeListener(
 			  bind(&updateSimPressPartner, chord, _id, placeholders::_1));
+			updatePartners();
 		}
 		return &_simMappings[chord];
 	}
@@ -459,6 +467,7 @@ public:
 			_diagMappings.emplace(chord, var);
 			_mapping[chord] = _diagMappings[chord].addOnChangeListener(
 			  bind(&updateDiagPressPartner, chord, _id, placeholders::_1));
+			updatePartners();
 		}
 		return &_diagMappings[chord];
 	}
@@ -495,6 +504,7 @@ public:
 			if (chordVar != _simMappings.end())
 			{
 				_simMappings.erase(chordVar);
+				updatePartners();
 			}
 		}
 	}
@@ -507,6 +517,7 @@ public:
 			if (chordVar != _diagMappings.end())
 			{
 				_diagMappings.erase(chordVar);
+				updatePartners();
 			}
 		}
 	}
@@ -7,6 +7,7 @@
 #include "JslWrapper.h"
 #include "SettingsManager.h"
 #include "../src/quatMaths.cpp"
+#include <span>
 
 // An instance of this class represents a single controller device that JSM is listening to.
 class JoyShock
@@ -16,8 +17,22 @@ public:
 
 	~JoyShock();
 
+	// Positions of the sticks read on one poll. They are processed together so that orientation, length and
+	// deadzones are computed for all of them in a few passes over packed arrays before each stick mode runs.
+	struct StickBatch
+	{
+		static constexpr int MAX_STICKS = 3; // left, right and motion
+		int count = 0;
+		array<Stick *, MAX_STICKS> sticks;
+		array<bool *, MAX_STICKS> anyStickInput;
+		array<float, MAX_STICKS> x;
+		array<float, MAX_STICKS> y;
+
+		void add(Stick &stick, float stickX, float stickY, bool &anyInput);
+	};
+
 	// These two large functions are defined further down
-	void processStick(float stickX, float stickY, Stick &stick, float mouseCalibrationFactor, float deltaTime, bool &anyStickInput, bool &lockMouse, float &camSpeedX, float &camSpeedY);
+	void processSticks(StickBatch &batch, float mouseCalibrationFactor, float deltaTime, bool &lockMouse, float &camSpeedX, float &camSpeedY);
 
 	void handleTouchStickChange(TouchStick &ts, bool down, short movX, short movY, float delta_time);
 
@@ -45,8 +60,16 @@ public:
 	template<>
 	AxisSignPair getSetting<AxisSignPair>(SettingID index);
 
+	template<>
+	GyroSensCurve getSetting<GyroSensCurve>(SettingID index);
+
 	void getSmoothedGyro(float x, float y, float length, float bottomThreshold, float topThreshold, int maxSamples, float &outX, float &outY);
 
+	// Record an unsmoothed gyro sample and push outX and outY by how much the angular velocity is expected to
+	// change over the next horizon seconds, following the trend of the last MAGIC_GYRO_PREDICTION_WINDOW.
+	// The change on each axis is capped to maxChange and to the axis' own speed, and never makes the output switch direction.
+	void predictGyro(float x, float y, float deltaTime, float horizon, float maxChange, float &outX, float &outY);
+
 	void handleButtonChange(ButtonID id, bool pressed, int touchpadID = -1);
 
 	void handleTriggerChange(ButtonID softIndex, ButtonID fullIndex, TriggerMode mode, float position, AdaptiveTriggerSetting &trigger_rumble);
@@ -58,8 +81,26 @@ public:
 
 	void updateGridSize();
 
+	// Called by the deadline thread of the context, under the callback lock
+	void fireDeadlines(chrono::steady_clock::time_point now);
+
+	// Current state of a plain controller button, or nothing when it can't be read outside of a poll
+	optional<bool> isPhysicallyPressed(ButtonID id, int buttons) const;
+
 	bool processGyroStick(float stickX, float stickY, float stickLength, StickMode stickMode, bool forceOutput);
 
+	// Stick curves compiled from the active settings. The tables are only rebuilt when a setting changes.
+	const PowerCurve &getStickPowerCurve();
+
+	const StickResponse &getVirtualStickResponse(bool isLeft);
+
+	// Sine of LEAN_THRESHOLD, only recomputed when the setting changes
+	float getSinLeanThreshold();
+
+	// Returns true when the controller has been left alone long enough for this poll to be skipped.
+	// An idle controller is still fully processed once every IDLE_TICK_TIME. Gyro calibration is never skipped.
+	bool skipIdlePoll(const IMU_STATE &imu, chrono::steady_clock::time_point timeNow);
+
 	shared_ptr<DigitalButton::Context> _context;
 	vector<DigitalButton> _buttons;
 	vector<DigitalButton> _gridButtons;
@@ -69,12 +110,11 @@ public:
 	int _handle;
 	int _controllerType;
 	int _splitType = 0;
+	string _deviceId; // Used to persist calibration across reconnects
 
 
-	float neutralQuatW = 1.0f;
-	float neutralQuatX = 0.0f;
-	float neutralQuatY = 0.0f;
-	float neutralQuatZ = 0.0f;
+	// Inverse of the neutral orientation set by SET_MOTION_STICK_NEUTRAL, applied to gravity on every poll
+	RotationMatrix neutralInverse;
 
 	bool set_neutral_quat = false;
 
@@ -103,17 +143,107 @@ private:
 	// this large functions is defined further down
 	float handleFlickStick(float stickX, float stickY, Stick &stick, float stickLength, StickMode mode);
 
-	bool isSoftPullPressed(int triggerIndex, float triggerPosition);
+	// In seconds, FLICK_TIME scaled by FLICK_TIME_EXPONENT for the size of the flick
+	float getFlickDuration(float deltaFlick);
+
+	// Values shared by the stick mode handlers for one stick on one frame
+	struct StickFrame
+	{
+		float stickX;
+		float stickY;
+		float stickLength;
+		float rawX;
+		float rawY;
+		float rawLength;
+		float rawLastX;
+		float rawLastY;
+		float innerDeadzone;
+		float outerDeadzone;
+		bool pegged;
+		StickMode stickMode;
+		float deltaTime;
+		bool &anyStickInput;
+		bool &lockMouse;
+		float &camSpeedX;
+		float &camSpeedY;
+	};
+
+	// processSticks dispatches to one of these handlers, indexed by stick mode
+	using StickModeHandler = void (JoyShock::*)(Stick &stick, StickFrame &frame);
+	static const array<StickModeHandler, size_t(StickMode::INVALID) + 1> STICK_MODE_HANDLERS;
+
+	void processStickNone(Stick &stick, StickFrame &frame);
+	void processStickIgnored(Stick &stick, StickFrame &frame);
+	void processStickFlick(Stick &stick, StickFrame &frame);
+	void processStickAim(Stick &stick, StickFrame &frame);
+	void processStickMouseArea(Stick &stick, StickFrame &frame);
+	void processStickMouseRing(Stick &stick, StickFrame &frame);
+	void processStickScrollWheel(Stick &stick, StickFrame &frame);
+	void processStickButtons(Stick &stick, StickFrame &frame);
+	void processStickVirtual(Stick &stick, StickFrame &frame);
+	void processStickAngleToAxis(Stick &stick, StickFrame &frame);
+	void processStickWind(Stick &stick, StickFrame &frame);
+	void processStickHybridAim(Stick &stick, StickFrame &frame);
+
+	// Hair trigger samples of one analog trigger, as a ring starting at front
+	struct TriggerHistory
+	{
+		array<float, MAGIC_TRIGGER_SMOOTHING> positions = {};
+		int front = 0;
+
+		// Record a sample and return whether the trigger is clearly being pulled (true) or released (false)
+		optional<bool> push(float position);
+	};
 
-	float getTriggerEffectStartPos();
+	// Settings and state shared by the dual stage trigger handlers for one trigger on one report
+	struct TriggerFrame
+	{
+		ButtonID softIndex;
+		ButtonID fullIndex;
+		TriggerMode mode;
+		float position;
+		AdaptiveTriggerSetting &effect;
+		uint8_t offset;
+		uint8_t range;
+		float effectStartPos;
+		float skipDelay;
+		bool softPressed;
+		DstState &state;
+	};
+
+	// handleTriggerChange dispatches to one of these handlers, indexed by dual stage trigger state
+	using TriggerStateHandler = void (JoyShock::*)(TriggerFrame &frame);
+	static const array<TriggerStateHandler, size_t(DstState::INVALID) + 1> TRIGGER_STATE_HANDLERS;
+
+	void handleTriggerNoPress(TriggerFrame &frame);
+	void handleTriggerPressStart(TriggerFrame &frame);
+	void handleTriggerPressStartResp(TriggerFrame &frame);
+	void handleTriggerQuickSoftTap(TriggerFrame &frame);
+	void handleTriggerQuickFullPress(TriggerFrame &frame);
+	void handleTriggerQuickFullRelease(TriggerFrame &frame);
+	void handleTriggerSoftPress(TriggerFrame &frame);
+	void handleTriggerDelayFullPress(TriggerFrame &frame);
+	void handleTriggerExclFullPress(TriggerFrame &frame);
+	void handleTriggerInvalid(TriggerFrame &frame);
+
+	// previousReports are the trigger positions received before triggerPosition since the last poll
+	bool isSoftPullPressed(int triggerIndex, float threshold, float triggerPosition, span<const float> previousReports);
+
+	// TRIGGER_THRESHOLD, where negative values mean hair trigger
+	float getTriggerThreshold();
 
 	template<typename E>
 	optional<E> getSettingAtChord(SettingID id, ButtonID chord);
 
 	void sendRumble(int smallRumble, int bigRumble);
 
-	DigitalButton *getMatchingSimBtn(ButtonID index);
-	DigitalButton *getMatchingDiagBtn(ButtonID index, optional<MapIterator> &iter);
+	DigitalButton *getButton(ButtonID index);
+
+	// The sim press partner of index in the same state, if any
+	DigitalButton *getMatchingSimBtn(ButtonID index, ComboPartner &partner);
+
+	// The first diagonal press partner of index that is pressed, from the partner at position next onward
+	DigitalButton *getMatchingDiagBtn(ButtonID index, size_t &next, ComboPartner &partner);
 
 	void resetSmoothSample();
 
@@ -128,16 +258,37 @@ private:
 	array<FloatXY, MAX_GYRO_SAMPLES> _gyroSamples;
 	int _frontGyroSample = 0;
 
+	static constexpr int MAX_PREDICTION_SAMPLES = 32;
+	array<FloatXY, MAX_PREDICTION_SAMPLES> _predictionSamples; // unsmoothed gyro, newest first from _frontPredictionSample
+	array<float, MAX_PREDICTION_SAMPLES> _predictionDeltas = { 0.f }; // seconds elapsed since the previous sample
+	int _frontPredictionSample = 0;
+	int _numPredictionSamples = 0;
+
 	Vec _lastGrav = Vec(0.f, -1.f, 0.f);
 
 	float _windingAngleLeft = 0.f;
 	float _windingAngleRight = 0.f;
 
+	PowerCurve _stickPowerCurve;
+	PowerCurve _windStickPowerCurve;
+	StickResponse _leftStickResponse;
+	StickResponse _rightStickResponse;
+	float _leanThreshold = 0.f;
+	float _sinLeanThreshold = 0.f;
+
 	ScrollAxis _touchScrollX;
 	ScrollAxis _touchScrollY;
 
 	vector<DstState> _triggerState; // State of analog triggers when skip mode is active
-	vector<deque<float>> _prevTriggerPosition;
+	array<TriggerHistory, NUM_ANALOG_TRIGGERS> _triggerHistory;
+	array<bool, NUM_ANALOG_TRIGGERS> _pendingSoftRelease = {}; // A hair trigger pull was released during the last poll
+	static constexpr int MAX_TRIGGER_REPORTS = 32;
+
+	// Idle detection
+	chrono::steady_clock::time_point _lastActivity;
+	chrono::steady_clock::time_point _lastIdlePoll;
+	array<float, 6> _idleAnalog = { 0.f }; // sticks and triggers when the controller was last touched
+	IMU_STATE _lastImu = {};
 };
 
 template<typename E>
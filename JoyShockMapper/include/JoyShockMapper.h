@@ -8,6 +8,8 @@
 #include <string>
 #include <memory>
 #include <array>
+#include <vector>
+#include <algorithm>
 
 // This header file is meant to be included among all core JSM source files
 // And as such it should contain only constants, types and functions related to them
@@ -233,6 +235,13 @@ enum class SettingID
 	MOUSELIKE_FACTOR,
 	RETURN_DEADZONE_ANGLE,
 	RETURN_DEADZONE_ANGLE_CUTOFF,
+	MOTION_ENGINE,
+	IDLE_TICK_TIME,
+	GYRO_SENS_CURVE,
+	GYRO_PREDICTION_TIME,
+	GYRO_PREDICTION_CAP,
+	FLICK_OUTPUT_RATE,
+	HIRES_SCROLL,
 };
 
 // constexpr are like #define but with respect to typeness
@@ -246,6 +255,13 @@ constexpr float MAGIC_TAP_DURATION = 40.0f;           // in milliseconds.
 constexpr float MAGIC_INSTANT_DURATION = 40.0f;       // in milliseconds
 constexpr float MAGIC_EXTENDED_TAP_DURATION = 500.0f; // in milliseconds
 constexpr int MAGIC_TRIGGER_SMOOTHING = 5;            // in samples
+constexpr float MAGIC_STILLNESS_GYRO_DELTA = 1.2f;    // in degrees per second
+constexpr float MAGIC_STILLNESS_ACCEL_DELTA = 0.015f; // in Gs
+constexpr float MAGIC_IDLE_ANALOG_DELTA = 0.02f;      // stick and trigger noise, in normalized units
+constexpr float MAGIC_IDLE_GYRO_SPEED = 1.0f;         // calibrated gyro noise, in degrees per second
+constexpr float MAGIC_IDLE_DELAY = 2000.0f;           // in milliseconds
+constexpr float MAGIC_GYRO_PREDICTION_WINDOW = 20.0f; // in milliseconds
+constexpr float MAGIC_HYBRID_AIM_WINDOW = 16.0f;      // in milliseconds
 
 enum class GyroSpace
 {
@@ -396,6 +412,13 @@ enum class ControllerScheme
 	INVALID
 };
 
+enum class MotionEngine
+{
+	GAMEPAD_MOTION, // Full sensor fusion
+	COMPLEMENTARY,  // Gravity only, cheaper
+	INVALID
+};
+
 enum class TouchpadMode
 {
 	GRID_AND_STICK, // Grid and Stick
@@ -472,6 +495,41 @@ struct GyroSettings
 	GyroIgnoreMode ignore_mode = GyroIgnoreMode::BUTTON;
 };
 
+// Gyro acceleration curve given as pairs of gyro speed in degrees per second and sensitivity.
+// Sensitivity is linearly interpolated between points and held flat past both ends.
+// Copies share the same points. A default constructed curve is empty and means "no curve".
+class GyroSensCurve
+{
+public:
+	GyroSensCurve() = default;
+
+	GyroSensCurve(vector<FloatXY> points);
+
+	inline bool empty() const
+	{
+		return !_points;
+	}
+
+	const vector<FloatXY> &points() const;
+
+	// The curves have few points: the segment is looked up and interpolated exactly
+	inline float evaluate(float speed) const
+	{
+		auto upper = upper_bound(_points->begin(), _points->end(), speed, [](float value, const FloatXY &point)
+		  { return value < point.x(); });
+		if (upper == _points->begin())
+			return upper->y();
+		auto lower = prev(upper);
+		if (upper == _points->end())
+			return lower->y();
+		float t = (speed - lower->x()) / (upper->x() - lower->x());
+		return lower->y() + (upper->y() - lower->y()) * t;
+	}
+
+private:
+	shared_ptr<const vector<FloatXY>> _points; // sorted by speed
+};
+
 class Mapping;
 
 // This function is defined in main.cpp. It enables two sim press variables to
@@ -500,6 +558,9 @@ ostream &operator<<(ostream &out, E rhv)
 istream &operator>>(istream &in, ButtonID &rhv);
 ostream &operator<<(ostream &out, const ButtonID &rhv);
 
+// Same as operator<<, without formatting
+string_view buttonName(ButtonID id);
+
 istream &operator>>(istream &in, FlickSnapMode &fsm);
 ostream &operator<<(ostream &out, const FlickSnapMode &fsm);
 
@@ -529,6 +590,14 @@ inline bool operator!=(const AxisSignPair& lhs, const AxisSignPair& rhs)
 	return !(lhs == rhs);
 }
 
+istream &operator>>(istream &in, GyroSensCurve &curve);
+ostream &operator<<(ostream &out, const GyroSensCurve &curve);
+bool operator==(const GyroSensCurve &lhs, const GyroSensCurve &rhs);
+inline bool operator!=(const GyroSensCurve &lhs, const GyroSensCurve &rhs)
+{
+	return !(lhs == rhs);
+}
+
 istream &operator>>(istream &in, Color &color);
 ostream &operator<<(ostream &out, const Color &color);
 bool operator==(const Color &lhs, const Color &rhs);
@@ -542,6 +611,8 @@ istream &operator>>(istream &in, AxisMode &am);
 
 istream &operator>>(istream &in, PathString &fxy);
 
+// Messages are formatted on the calling thread and written out on the console right away, except on
+// controller polling threads, which hand them over to a logging thread instead of waiting on the console.
 class Log
 {
 public:
@@ -555,37 +626,81 @@ public:
 		ERR,
 	};
 
+	// Messages below this level are not even formatted
+#if defined(NDEBUG) // release
+	static constexpr Level MIN_LEVEL = Level::BASE;
+#else
+	static constexpr Level MIN_LEVEL = Level::UT;
+#endif
+
 protected:
-	// https://stackoverflow.com/questions/11826554/standard-no-op-output-stream
-	class NullBuffer : public std::streambuf
+	// Formats a message in memory that is reused by the following messages of the same thread
+	class Buffer : public std::streambuf
 	{
 	public:
+		string _text;
+
+	protected:
 		int overflow(int c) override
 		{
+			if (c != traits_type::eof())
+			{
+				_text.push_back(char(c));
+			}
 			return c;
 		}
+
+		streamsize xsputn(const char *s, streamsize n) override
+		{
+			_text.append(s, size_t(n));
+			return n;
+		}
 	};
-	unique_ptr<streambuf> _buf;
 
-	static streambuf *makeBuffer(Level level);
+	struct Slot;
+	Level _level;
+	Slot &_slot;
+
+	// Messages logged while formatting another one get their own slot
+	static thread_local vector<unique_ptr<Slot>> _slots;
+	static thread_local size_t _slotsInUse;
+	static thread_local bool _hotThread;
+
+	static Slot &acquireSlot();
+	static void releaseSlot();
+
+	// Print the message, or queue it for the logging thread on a hot thread
+	static void push(Level level, string_view text);
 
 public:
-	Log(Level level)
-	  : _buf(makeBuffer(level))
-	  , _str(_buf.get())
+	Log(Level level);
+	~Log();
+
+	// Write a message out on the console. Platform specific, called by the logger only, one message at a time.
+	static void print(Level level, string_view text);
+
+	// Controller polling threads must never wait on the console: their messages are queued, and dropped
+	// when the log can't keep up.
+	static void setHotThread()
 	{
+		_hotThread = true;
 	}
-	~Log() { }
 
-	ostream _str;
+	ostream &_str;
 };
 
-// This trickery doesn't work in Linux does it? :(
-#define CERR Log(Log::Level::ERR)._str
-#define COUT Log(Log::Level::BASE)._str
-#define COUT_INFO Log(Log::Level::INFO)._str
-#define COUT_WARN Log(Log::Level::WARN)._str
-#define DEBUG_LOG Log(Log::Level::UT)._str
-#define COUT_BOLD Log(Log::Level::BOLD)._str
+#define LOG_AT(level) \
+	if constexpr (level < Log::MIN_LEVEL) \
+	{ \
+	} \
+	else \
+		Log(level)._str
+
+#define CERR LOG_AT(Log::Level::ERR)
+#define COUT LOG_AT(Log::Level::BASE)
+#define COUT_INFO LOG_AT(Log::Level::INFO)
+#define COUT_WARN LOG_AT(Log::Level::WARN)
+#define DEBUG_LOG LOG_AT(Log::Level::UT)
+#define COUT_BOLD LOG_AT(Log::Level::BOLD)
 
 bool do_RECONNECT_CONTROLLERS(string_view arguments, std::function<void()> loadOnReconnect);
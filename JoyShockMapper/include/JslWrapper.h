@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <iostream>
+#include <string>
 
 enum class AdaptiveTriggerMode : unsigned char
 {
@@ -229,4 +230,11 @@ public:
 	virtual void SetPlayerNumber(int deviceId, int number) = 0;
 	virtual void SetTriggerEffect(int deviceId, const AdaptiveTriggerSetting &_leftTriggerEffect, const AdaptiveTriggerSetting &_rightTriggerEffect) { };
 	virtual void SetMicLight(int deviceId, unsigned char mode) { }
+	// Trigger positions of every report received since the last call, oldest first. Returns how many were written.
+	// Backends that only expose the latest state return 0.
+	virtual int GetTriggerHistory(int deviceId, bool isLeft, float *positions, int maxPositions) { return 0; }
+	// Forget the trigger reports of a poll that won't process them
+	virtual void ClearTriggerHistory(int deviceId) { }
+	// Unique identity of the physical device across reconnects, or empty if unavailable
+	virtual std::string GetDeviceIdentifier(int deviceId) { return std::string(); }
 };
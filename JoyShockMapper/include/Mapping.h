@@ -3,11 +3,75 @@
 #include "JoyShockMapper.h"
 #include "PlatformDefinitions.h"
 
+class EventActionIf;
+struct ActionProgram;
+
+// A single step of a compiled mapping. Primitive ops call the matching EventActionIf function,
+// while composite ops hand over primitive ops to be run later by the button.
+struct Action
+{
+	enum class Op : uint8_t
+	{
+		None,
+		Press,
+		Release,
+		GyroAction,
+		RemoveGyroAction,
+		Rumble,
+		StopRumble,
+		StartCalibration,
+		FinishCalibration,
+		Command,
+		// Composite ops
+		Toggle,  // Toggle between apply and release on each run
+		Instant, // Run release at the end of the instant window of instantEvent
+	};
+
+	Op op = Op::None;
+	Op apply = Op::None;
+	Op release = Op::None;
+	BtnEvent instantEvent = BtnEvent::INVALID;
+	uint16_t key = 0; // Index in the keys of the program
+	int smallRumble = 0;
+	int bigRumble = 0;
+};
+
+// A primitive action bound to the program that holds its key, to be run once the button requires it.
+class BoundAction
+{
+public:
+	BoundAction() = default;
+
+	BoundAction(nullptr_t)
+	  : BoundAction()
+	{
+	}
+
+	BoundAction(const shared_ptr<const ActionProgram> &program, Action::Op op, const Action &action)
+	  : _program(program)
+	  , _op(op)
+	  , _action(&action)
+	{
+	}
+
+	void operator()(EventActionIf *btn) const;
+
+	explicit operator bool() const
+	{
+		return _op != Action::Op::None;
+	}
+
+private:
+	shared_ptr<const ActionProgram> _program; // Keeps _action alive
+	Action::Op _op = Action::Op::None;
+	const Action *_action = nullptr;
+};
+
 // The list of different function that can be bound in the mapping
 class EventActionIf
 {
 public:
-	typedef function<void(EventActionIf *)> Callback;
+	typedef BoundAction Callback;
 
 	virtual void RegisterInstant(BtnEvent evt, Callback cb) = 0;
 	virtual void ApplyGyroAction(KeyCode gyroAction) = 0;
@@ -18,9 +82,31 @@ public:
 	virtual void ApplyButtonToggle(KeyCode key, Callback apply, Callback release) = 0;
 	virtual void StartCalibration() = 0;
 	virtual void FinishCalibration() = 0;
+	virtual void RunCommand(KeyCode command) = 0;
 	virtual const char *getDisplayName() = 0;
 };
 
+// The actions of a mapping, stored contiguously and grouped by event. A program is shared between
+// all the copies of a mapping and is never modified once shared.
+struct ActionProgram
+{
+	vector<KeyCode> keys;
+	vector<Action> actions;
+	// The actions of event e are in [eventStart[e], eventStart[e + 1])
+	array<uint16_t, size_t(BtnEvent::INVALID) + 1> eventStart{};
+
+	inline bool hasEvent(BtnEvent evt) const
+	{
+		return eventStart[size_t(evt)] != eventStart[size_t(evt) + 1];
+	}
+
+	size_t eventCount() const;
+
+	void insert(BtnEvent evt, const Action &action);
+
+	static void run(const shared_ptr<const ActionProgram> &program, Action::Op op, const Action &action, EventActionIf *btn);
+};
+
 // This structure handles the mapping of a button, buy processing and action
 // to be done on tap, hold, turbo and others. It holds a map of actions to perform
 // when a specific event happens. This replaces the old Mapping structure.
@@ -56,15 +142,30 @@ public:
 	friend ostream &operator<<(ostream &out, const Mapping &mapping);
 
 private:
-	string _description = "no input";
-	string _command;
+	// Everything a mapping holds. A binding is never modified once built and is shared by all the copies
+	// of the mapping: a pressed button holds on to its binding without allocating, and keeps the
+	// generation it was pressed with if the mapping changes while it is held.
+	struct Binding
+	{
+		string description = "no input";
+		string command;
+		shared_ptr<const ActionProgram> program;
+		float tapDurationMs = MAGIC_TAP_DURATION;
+		bool hasViGEmBtn = false;
+	};
+
+	// Shared by all default constructed mappings
+	static const shared_ptr<const Binding> &emptyBinding();
+
+	shared_ptr<const Binding> _binding = emptyBinding();
 
-	map<BtnEvent, EventActionIf::Callback> _eventMapping;
-	float _tapDurationMs = MAGIC_TAP_DURATION;
-	bool _hasViGEmBtn = false;
+	// Start a new generation of the binding, to be modified
+	Binding &edit();
 
-	void InsertEventMapping(BtnEvent evt, EventActionIf::Callback action);
-	static void RunBothActions(EventActionIf *btn, EventActionIf::Callback action1, EventActionIf::Callback action2);
+	inline size_t eventCount() const
+	{
+		return _binding->program ? _binding->program->eventCount() : 0;
+	}
 
 public:
 	Mapping() = default;
@@ -78,12 +179,12 @@ public:
 
 	string_view description() const
 	{
-		return _description;
+		return _binding->description;
 	}
 
 	string_view command() const
 	{
-		return _command;
+		return _binding->command;
 	}
 	void ProcessEvent(BtnEvent evt, EventActionIf &button) const;
 
@@ -93,25 +194,26 @@ public:
 
 	inline bool isValid() const
 	{
-		return !_command.empty();
+		return !_binding->command.empty();
 	}
 
 	inline float getTapDuration() const
 	{
-		return _tapDurationMs;
+		return _binding->tapDurationMs;
 	}
 
 	inline void clear()
 	{
-		_eventMapping.clear();
-		_description.clear();
-		_tapDurationMs = MAGIC_TAP_DURATION;
-		_hasViGEmBtn = false;
+		Binding &binding = edit();
+		binding.program.reset();
+		binding.description.clear();
+		binding.tapDurationMs = MAGIC_TAP_DURATION;
+		binding.hasViGEmBtn = false;
 	}
 
 	inline bool hasViGEmBtn() const
 	{
-		return _hasViGEmBtn;
+		return _binding->hasViGEmBtn;
 	}
 };
 
@@ -1,11 +1,13 @@
 #pragma once
 
+#include "JoyShockMapper.h"
+
 class MotionIf
 {
 protected:
 	MotionIf(){};
 public:
-	static MotionIf* getNew();
+	static MotionIf* getNew(MotionEngine engine = MotionEngine::GAMEPAD_MOTION);
 	virtual ~MotionIf() {};
 	
 
@@ -24,6 +26,7 @@ public:
 	virtual void StartContinuousCalibration() = 0;
 	virtual void PauseContinuousCalibration() = 0;
 	virtual void ResetContinuousCalibration() = 0;
+	virtual bool IsCalibrating() = 0;
 	virtual void GetCalibrationOffset(float& xOffset, float& yOffset, float& zOffset) = 0;
 	virtual void SetCalibrationOffset(float xOffset, float yOffset, float zOffset, int weight) = 0;
 	virtual void SetAutoCalibration(bool enabled, float gyroThreshold, float accelThreshold) = 0;
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <cstdint>
+#include <optional>
 
 // https://docs.microsoft.com/en-us/windows/win32/inputdev/virtual-key-codes
 // Only use undefined keys from the above list for JSM custom commands
@@ -71,32 +73,18 @@ constexpr bool isControllerKey(uint16_t code)
 // Needs to be accessed publicly
 uint16_t nameToKey(std::string_view name);
 
+// A key binding. Names are interned in a global table that is never emptied, so a key code is a couple
+// of integers that is cheap to copy and compare, and the name is only looked up for display.
 struct KeyCode
 {
 	uint16_t code = NO_HOLD_MAPPED;
-	std::string name = "None";
+	uint16_t nameId = 0; // "None"
 
 	KeyCode() = default;
 
-	KeyCode(std::string_view keyName)
-	  : code(nameToKey(keyName))
-	  , name()
-	{
-		if (code == COMMAND_ACTION)
-			name = keyName.substr(1, keyName.size() - 2); // Remove opening and closing quotation marks
-		else if (keyName.compare("SMALL_RUMBLE") == 0)
-		{
-			name = SMALL_RUMBLE;
-			code = RUMBLE;
-		}
-		else if (keyName.compare("BIG_RUMBLE") == 0)
-		{
-			name = BIG_RUMBLE;
-			code = RUMBLE;
-		}
-		else if (code != 0)
-			name = keyName;
-	}
+	KeyCode(std::string_view keyName);
+
+	std::string_view name() const;
 
 	inline bool isValid() const
 	{
@@ -105,13 +93,20 @@ struct KeyCode
 
 	inline bool operator==(const KeyCode &rhs) const
 	{
-		return code == rhs.code && name == rhs.name;
+		return code == rhs.code && nameId == rhs.nameId;
 	}
 
 	inline bool operator!=(const KeyCode &rhs) const
 	{
 		return !operator==(rhs);
 	}
+
+	// Returns the id of name in the table, adding it if it isn't there yet. Empty once all ids are taken.
+	static std::optional<uint16_t> intern(std::string_view name);
+
+private:
+	// Intern the name, or make the key invalid when the table is full
+	void setName(std::string_view keyName);
 };
 
 
@@ -3,6 +3,7 @@
 #include "JoyShockMapper.h"
 #include "DigitalButton.h"
 #include <chrono>
+#include <cmath>
 
 class JoyShock;
 
@@ -35,10 +36,130 @@ public:
 
 	void processScroll(float distance, float sens, chrono::steady_clock::time_point now);
 
+	// Scroll the mouse wheel directly by distance / sens notches, bypassing the bindings
+	void processHiResScroll(float distance, float sens, chrono::steady_clock::time_point now);
+
 	void reset(chrono::steady_clock::time_point now);
 };
 
 
+// Lookup table of x to the power of an exponent over [0, 1], so stick curves can be evaluated
+// every frame without calling pow(). The table is only rebuilt when the exponent changes.
+// Values outside of [0, 1] fall back to pow().
+class PowerCurve
+{
+public:
+	static constexpr int TABLE_SIZE = 1024;
+
+	PowerCurve();
+
+	void setExponent(float exponent);
+
+	inline float operator()(float x) const
+	{
+		if (_exponent == 1.f)
+			return x;
+		if (!(x >= 0.f && x <= 1.f))
+			return pow(x, _exponent);
+		float index = x * (TABLE_SIZE - 1);
+		int i = min(int(index), TABLE_SIZE - 2);
+		return _values[i] + (_values[i + 1] - _values[i]) * (index - i);
+	}
+
+private:
+	float _exponent = 1.f;
+	array<float, TABLE_SIZE> _values;
+};
+
+// Output shaping of a virtual stick, compiled from its UNDEADZONE and UNPOWER settings.
+class StickResponse
+{
+public:
+	// The curves are only rebuilt when UNPOWER changes
+	void update(float undeadzoneInner, float undeadzoneOuter, float unpower);
+
+	inline float undeadzoneInner() const
+	{
+		return _undeadzoneInner;
+	}
+
+	inline float livezoneSize() const
+	{
+		return _livezoneSize;
+	}
+
+	// Stick position to stick strength, as the game sees it
+	inline float power(float x) const
+	{
+		return _power(x);
+	}
+
+	// Stick strength to stick position
+	inline float unpower(float x) const
+	{
+		return _unpower(x);
+	}
+
+	// Stick strength in [0, 1] to the value sent to the virtual stick
+	inline float remap(float x) const
+	{
+		x = _unpower(x);
+		return x < 1.f ? _undeadzoneInner + x * _livezoneSize : x;
+	}
+
+private:
+	float _undeadzoneInner = 0.f;
+	float _livezoneSize = 1.f;
+	PowerCurve _power;
+	PowerCurve _unpower;
+};
+
+// Moving average of the hybrid aim velocities and outputs over a time window rather than a
+// number of frames, so that smoothing feels the same at any TICK_TIME or controller poll rate.
+// Sums are kept up to date as samples come and go, so each frame costs the same.
+class HybridAimFilter
+{
+public:
+	struct Sample
+	{
+		float velocityX = 0.f;
+		float velocityY = 0.f;
+		float outputX = 0.f;
+		float outputY = 0.f;
+		float outputRadial = 0.f;
+	};
+
+	static constexpr int MAX_SAMPLES = 64;
+
+	// Add the sample of the current frame and drop the ones older than window seconds.
+	// The latest sample is always kept.
+	void push(const Sample &sample, float deltaTime, float window);
+
+	inline int count() const
+	{
+		return _count;
+	}
+
+	// Mean of the samples in the window, all zeros when empty
+	Sample average() const;
+
+private:
+	void add(const Sample &sample, double sign);
+
+	array<Sample, MAX_SAMPLES> _samples;
+	array<double, MAX_SAMPLES> _times = {};
+	int _front = 0; // index of the oldest sample
+	int _count = 0;
+	double _time = 0.;
+	// doubles so that rounding errors of adding and removing don't build up
+	double _sumVelocityX = 0.;
+	double _sumVelocityY = 0.;
+	double _sumOutputX = 0.;
+	double _sumOutputY = 0.;
+	double _sumOutputRadial = 0.;
+};
+
+
 struct Stick
 {
 	Stick(SettingID innerDeadzone,
@@ -78,6 +199,7 @@ struct Stick
 	float delta_flick = 0.0;
 	float flick_percent_done = 0.0;
 	float flick_rotation_counter = 0.0;
+	bool flick_streamed = false; // animated by the flick output thread rather than per poll
 	ScrollAxis scroll;
 	float acceleration = 1.0;
 
@@ -92,13 +214,7 @@ struct Stick
 	// Hybrid aim
 	float edgePushAmount = 0.0f;
 	float smallestMagnitude = 0.f;
-	static constexpr int SMOOTHING_STEPS = 4;
-	float previousOutputX[SMOOTHING_STEPS] = {};
-	float previousOutputY[SMOOTHING_STEPS] = {};
-	float previousOutputRadial[SMOOTHING_STEPS] = {};
-	float previousVelocitiesX[SMOOTHING_STEPS] = {};
-	float previousVelocitiesY[SMOOTHING_STEPS] = {};
-	int smoothingCounter = 0;
+	HybridAimFilter hybridAimFilter;
 };
 
 struct TouchStick : public Stick
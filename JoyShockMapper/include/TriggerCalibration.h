@@ -0,0 +1,66 @@
+#pragma once
+
+#include "InputHelpers.h"
+#include "JslWrapper.h"
+#include <chrono>
+
+class JoyShock;
+
+namespace JSM
+{
+
+// Measures the adaptive trigger offset and range of a single dualsense on its own timer, so the
+// other controllers keep being polled at the usual rate. The resistance is moved with a binary search
+// instead of one step per poll: the trigger is pressed softly against it, so the reported position
+// only starts to rise once the resistance is past the offset, and only reaches full pull past the range.
+// The results are written into the LEFT/RIGHT_TRIGGER_OFFSET and RANGE settings: like any assignment, they
+// last until those settings are set again or reset.
+class TriggerCalibration : public PollingThread
+{
+public:
+	TriggerCalibration(shared_ptr<JslWrapper> joyshock);
+	virtual ~TriggerCalibration();
+
+	// Begin calibrating both triggers of jc. Fails if a calibration is already in progress.
+	bool start(shared_ptr<JoyShock> jc);
+
+	// The poll callback of the device being calibrated must not touch its trigger effects
+	bool isCalibrating(int handle);
+
+private:
+	enum class Step
+	{
+		WAIT_RIGHT,
+		RIGHT_OFFSET,
+		RIGHT_END,
+		WAIT_LEFT,
+		LEFT_OFFSET,
+		LEFT_END,
+	};
+
+	// Time given to the trigger motor to move the resistance before the position is read back
+	static constexpr chrono::milliseconds SETTLE_TIME{ 100 };
+
+	bool TriggerCalibrationPoll(void *param);
+
+	// Narrow down the search with the position read back for the current probe.
+	// Returns true once the lowest effect position satisfying the search is known.
+	bool bisect(bool found);
+
+	void probe(AdaptiveTriggerSetting &effect, int position);
+
+	bool isConnected();
+
+	void finish();
+
+	shared_ptr<JslWrapper> jsl;
+	shared_ptr<JoyShock> _jc;
+	atomic<int> _handle;
+	Step _step = Step::WAIT_RIGHT;
+	int _low = 0;
+	int _high = 0;
+	int _offset = 0;
+	chrono::steady_clock::time_point _settled;
+};
+
+} // namespace JSM
@@ -0,0 +1,192 @@
+#include "ButtonReplay.h"
+#include "DigitalButton.h"
+#include "SettingsManager.h"
+#include <fstream>
+
+extern vector<JSMButton> mappings;
+
+namespace JSM
+{
+
+namespace
+{
+
+// Give up on buttons that are still busy this long after the last recorded change, like a held turbo
+constexpr int MAX_REPLAY_TAIL_MS = 10000;
+
+struct RecordedChange
+{
+	int ms;
+	ButtonID id;
+	bool pressed;
+};
+
+bool readRecording(const string &fileName, vector<RecordedChange> &changes)
+{
+	ifstream file(fileName);
+	if (!file)
+	{
+		CERR << "Can't open the recording " << fileName << '\n';
+		return false;
+	}
+	string line;
+	for (int lineNumber = 1; getline(file, line); ++lineNumber)
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+		istringstream ss(line);
+		RecordedChange change;
+		string name;
+		int pressed = 0;
+		auto id = ss >> change.ms >> name >> pressed ? magic_enum::enum_cast<ButtonID>(name) : nullopt;
+		if (!id || int(*id) < 0 || int(*id) > LAST_ANALOG_TRIGGER || (!changes.empty() && change.ms < changes.back().ms))
+		{
+			CERR << fileName << ':' << lineNumber << ": expected \"<ms> <BUTTON> <1|0>\" in chronological order, got \"" << line << "\"\n";
+			return false;
+		}
+		change.id = *id;
+		change.pressed = pressed != 0;
+		changes.push_back(change);
+	}
+	return true;
+}
+
+// The controller buttons driven by a recording, with the same lookups as JoyShock provides to them
+class ButtonReplay
+{
+public:
+	ButtonReplay(function<void(ButtonID, string_view, string_view)> trace)
+	  : _context(make_shared<DigitalButton::Context>(trace))
+	{
+		_context->_getMatchingSimBtn = bind(&ButtonReplay::getMatchingSimBtn, this, placeholders::_1, placeholders::_2);
+		_context->_getMatchingDiagBtn = bind(&ButtonReplay::getMatchingDiagBtn, this, placeholders::_1, placeholders::_2, placeholders::_3);
+		_buttons.reserve(LAST_ANALOG_TRIGGER + 1);
+		for (int i = 0; i <= LAST_ANALOG_TRIGGER; ++i)
+		{
+			_buttons.push_back(DigitalButton(_context, mappings[i]));
+		}
+	}
+
+	// Send each button its state at time_now, the way JoyShock::handleButtonChange does on every poll
+	void poll(chrono::steady_clock::time_point time_now, const array<bool, LAST_ANALOG_TRIGGER + 1> &pressed)
+	{
+		for (auto &button : _buttons)
+		{
+			auto id = button._id;
+			bool isPressed = (!_context->nn && pressed[int(id)]) || (_context->nn > 0 && (id >= ButtonID::UP || id <= ButtonID::DOWN || id == ButtonID::S || id == ButtonID::E) && nnm.find(_context->nn) != nnm.end() && nnm.find(_context->nn)->second == id);
+			if (!isPressed && button.isIdle())
+				continue;
+			float turboTime = getSetting(SettingID::TURBO_PERIOD);
+			float holdTime = getSetting(SettingID::HOLD_PRESS_TIME);
+			float dblPressWindow = getSetting(SettingID::DBL_PRESS_WINDOW);
+			if (isPressed)
+				button.sendEvent(Pressed{ time_now, turboTime, holdTime, dblPressWindow });
+			else
+				button.sendEvent(Released{ time_now, turboTime, holdTime, dblPressWindow });
+		}
+	}
+
+	bool isIdle() const
+	{
+		return all_of(_buttons.begin(), _buttons.end(), [](const DigitalButton &button)
+		  { return button.getState() == BtnState::NoPress; });
+	}
+
+private:
+	// The chorded value of a timing setting, as JoyShock::getSetting finds it
+	float getSetting(SettingID id)
+	{
+		auto setting = SettingsManager::get<float>(id);
+		for (auto activeChord = _context->chordStack.begin(); activeChord != _context->chordStack.end(); activeChord++)
+		{
+			if (auto value = setting->chordedValue(*activeChord))
+				return *value;
+		}
+		return setting->value();
+	}
+
+	DigitalButton *getButton(ButtonID id)
+	{
+		return int(id) >= 0 && int(id) <= LAST_ANALOG_TRIGGER ? &_buttons[int(id)] : nullptr;
+	}
+
+	DigitalButton *getMatchingSimBtn(ButtonID index, ComboPartner &partner)
+	{
+		DigitalButton *button1 = getButton(index);
+		if (button1)
+		{
+			auto simPartners = button1->getMapping().getSimPartners();
+			for (auto &simPartner : *simPartners)
+			{
+				DigitalButton *button2 = getButton(simPartner.id);
+				if (button2 && button1->getState() == button2->getState())
+				{
+					partner = simPartner;
+					return button2;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	DigitalButton *getMatchingDiagBtn(ButtonID index, size_t &next, ComboPartner &partner)
+	{
+		DigitalButton *button1 = getButton(index);
+		if (button1)
+		{
+			auto diagPartners = button1->getMapping().getDiagPartners();
+			for (; next < diagPartners->size(); ++next)
+			{
+				DigitalButton *button2 = getButton((*diagPartners)[next].id);
+				if (button2 && button2->getState() != BtnState::NoPress)
+				{
+					partner = (*diagPartners)[next];
+					return button2;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	shared_ptr<DigitalButton::Context> _context;
+	vector<DigitalButton> _buttons;
+};
+
+} // namespace
+
+bool replayButtons(const string &fileName)
+{
+	vector<RecordedChange> changes;
+	if (!readRecording(fileName, changes))
+		return false;
+	if (changes.empty())
+	{
+		CERR << "The recording " << fileName << " has no button change\n";
+		return false;
+	}
+
+	int ms = 0;
+	ButtonReplay replay([&ms](ButtonID id, string_view action, string_view key)
+	  { COUT << ms << ' ' << id << ' ' << action << ' ' << key << '\n'; });
+
+	// Simulated time starts with the first change, so that the trace doesn't depend on when the replay is run
+	auto start = chrono::steady_clock::now();
+	array<bool, LAST_ANALOG_TRIGGER + 1> pressed{};
+	auto next = changes.begin();
+	for (ms = changes.front().ms; next != changes.end() || !replay.isIdle(); ++ms)
+	{
+		if (ms > changes.back().ms + MAX_REPLAY_TAIL_MS)
+		{
+			CERR << "Some buttons are still active " << MAX_REPLAY_TAIL_MS << "ms after the last change of the recording\n";
+			return false;
+		}
+		for (; next != changes.end() && next->ms <= ms; ++next)
+		{
+			pressed[int(next->id)] = next->pressed;
+		}
+		replay.poll(start + chrono::milliseconds(ms - changes.front().ms), pressed);
+	}
+	return true;
+}
+
+} // namespace JSM
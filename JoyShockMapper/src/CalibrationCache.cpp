@@ -0,0 +1,96 @@
+#include "CalibrationCache.h"
+#include "PlatformDefinitions.h"
+#include <fstream>
+
+namespace JSM
+{
+
+CalibrationCache::CalibrationCache(string_view fileName)
+  : _path(string{ BASE_JSM_CONFIG_FOLDER() } + string(fileName))
+{
+}
+
+CalibrationCache::~CalibrationCache()
+{
+	if (_loading.valid())
+	{
+		_loading.wait();
+	}
+}
+
+void CalibrationCache::loadAsync(function<void()> onLoaded)
+{
+	if (_loading.valid())
+	{
+		_loading.wait(); // Previous connection is still being restored
+	}
+	_loading = async(launch::async, [this, onLoaded]()
+	  {
+		  load();
+		  if (onLoaded)
+			  onLoaded();
+	  });
+}
+
+void CalibrationCache::load()
+{
+	lock_guard guard(_lock);
+	if (_loaded)
+		return;
+	_loaded = true;
+
+	ifstream file(_path);
+	string deviceId;
+	Offset offset;
+	while (file >> deviceId >> offset.x >> offset.y >> offset.z)
+	{
+		_entries[deviceId] = offset;
+	}
+	DEBUG_LOG << "Loaded " << _entries.size() << " gyro calibrations from " << _path << '\n';
+}
+
+optional<CalibrationCache::Offset> CalibrationCache::get(string_view deviceId)
+{
+	lock_guard guard(_lock);
+	auto entry = _entries.find(deviceId);
+	return entry != _entries.end() ? optional<Offset>(entry->second) : nullopt;
+}
+
+void CalibrationCache::set(string_view deviceId, const Offset &offset)
+{
+	load(); // Don't lose the entries of other devices on the next save
+	lock_guard guard(_lock);
+	auto entry = _entries.find(deviceId);
+	if (entry == _entries.end())
+	{
+		_entries.emplace(deviceId, offset);
+		_dirty = true;
+	}
+	else if (entry->second.x != offset.x || entry->second.y != offset.y || entry->second.z != offset.z)
+	{
+		entry->second = offset;
+		_dirty = true;
+	}
+}
+
+bool CalibrationCache::save()
+{
+	lock_guard guard(_lock);
+	if (!_dirty)
+		return true;
+
+	ofstream file(_path, ios::trunc);
+	if (!file)
+	{
+		CERR << "Cannot write the gyro calibration cache to " << _path << '\n';
+		return false;
+	}
+	for (auto &[deviceId, offset] : _entries)
+	{
+		file << deviceId << ' ' << offset.x << ' ' << offset.y << ' ' << offset.z << '\n';
+	}
+	_dirty = false;
+	return true;
+}
+
+} // namespace JSM
@@ -0,0 +1,240 @@
+#include "MotionIf.h"
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <algorithm>
+
+// A cheap alternative to GamepadMotion. Gravity is tracked by rotating the previous estimate with the
+// gyro and nudging it towards the accelerometer reading. There is no yaw reference, so the orientation
+// only represents tilt. This is enough for every gyro space JSM supports and the motion stick.
+class ComplementaryMotion : public MotionIf
+{
+	static constexpr float DEG_TO_RAD = float(M_PI / 180.);
+	static constexpr float CORRECTION_RATE = 2.5f;   // per second, how quickly gravity converges to the accelerometer
+	static constexpr float STILLNESS_TIME = 1.f;     // in seconds, before auto calibration starts sampling
+	static constexpr float AUTO_CALIBRATION_RATE = 0.5f; // per second, once the controller is still
+
+	float _gravX = 0.f;
+	float _gravY = -1.f;
+	float _gravZ = 0.f;
+
+	float _accelX = 0.f;
+	float _accelY = 0.f;
+	float _accelZ = 0.f;
+
+	float _gyroX = 0.f;
+	float _gyroY = 0.f;
+	float _gyroZ = 0.f;
+
+	float _offsetX = 0.f;
+	float _offsetY = 0.f;
+	float _offsetZ = 0.f;
+
+	// Manual calibration accumulates every sample while active
+	bool _calibrating = false;
+	double _calibrationSumX = 0.;
+	double _calibrationSumY = 0.;
+	double _calibrationSumZ = 0.;
+	int _calibrationCount = 0;
+
+	// Stillness based auto calibration
+	bool _autoCalibration = false;
+	float _gyroThreshold = 0.f;
+	float _accelThreshold = 0.f;
+	float _stillTime = 0.f;
+	float _lastRawGyroX = 0.f;
+	float _lastRawGyroY = 0.f;
+	float _lastRawGyroZ = 0.f;
+
+	void updateOffset()
+	{
+		if (_calibrationCount > 0)
+		{
+			_offsetX = float(_calibrationSumX / _calibrationCount);
+			_offsetY = float(_calibrationSumY / _calibrationCount);
+			_offsetZ = float(_calibrationSumZ / _calibrationCount);
+		}
+	}
+
+	void autoCalibrate(float gyroX, float gyroY, float gyroZ, float accelX, float accelY, float accelZ, float deltaTime)
+	{
+		float gyroDelta = max({ fabsf(gyroX - _lastRawGyroX), fabsf(gyroY - _lastRawGyroY), fabsf(gyroZ - _lastRawGyroZ) });
+		float accelDelta = max({ fabsf(accelX - _accelX), fabsf(accelY - _accelY), fabsf(accelZ - _accelZ) });
+		_stillTime = gyroDelta < _gyroThreshold && accelDelta < _accelThreshold ? _stillTime + deltaTime : 0.f;
+		if (_stillTime > STILLNESS_TIME)
+		{
+			float factor = min(deltaTime * AUTO_CALIBRATION_RATE, 1.f);
+			_offsetX += (gyroX - _offsetX) * factor;
+			_offsetY += (gyroY - _offsetY) * factor;
+			_offsetZ += (gyroZ - _offsetZ) * factor;
+		}
+	}
+
+public:
+	ComplementaryMotion() = default;
+
+	virtual ~ComplementaryMotion() = default;
+
+	virtual void reset() override
+	{
+		*this = ComplementaryMotion();
+	}
+
+	virtual void ProcessMotion(float gyroX, float gyroY, float gyroZ,
+	  float accelX, float accelY, float accelZ, float deltaTime) override
+	{
+		if (_calibrating)
+		{
+			_calibrationSumX += gyroX;
+			_calibrationSumY += gyroY;
+			_calibrationSumZ += gyroZ;
+			++_calibrationCount;
+			updateOffset();
+		}
+		else if (_autoCalibration)
+		{
+			autoCalibrate(gyroX, gyroY, gyroZ, accelX, accelY, accelZ, deltaTime);
+		}
+		_lastRawGyroX = gyroX;
+		_lastRawGyroY = gyroY;
+		_lastRawGyroZ = gyroZ;
+
+		_gyroX = gyroX - _offsetX;
+		_gyroY = gyroY - _offsetY;
+		_gyroZ = gyroZ - _offsetZ;
+		_accelX = accelX;
+		_accelY = accelY;
+		_accelZ = accelZ;
+
+		// Gravity is fixed in the world, so in controller space it rotates opposite to the gyro: dg/dt = -w x g
+		float wx = _gyroX * DEG_TO_RAD * deltaTime;
+		float wy = _gyroY * DEG_TO_RAD * deltaTime;
+		float wz = _gyroZ * DEG_TO_RAD * deltaTime;
+		float gx = _gravX - (wy * _gravZ - wz * _gravY);
+		float gy = _gravY - (wz * _gravX - wx * _gravZ);
+		float gz = _gravZ - (wx * _gravY - wy * _gravX);
+
+		// Then pull it towards the measured acceleration, which points away from gravity at rest
+		float correction = clamp(deltaTime * CORRECTION_RATE, 0.f, 1.f);
+		gx += (-accelX - gx) * correction;
+		gy += (-accelY - gy) * correction;
+		gz += (-accelZ - gz) * correction;
+
+		float length = sqrtf(gx * gx + gy * gy + gz * gz);
+		if (length > 0.f)
+		{
+			_gravX = gx / length;
+			_gravY = gy / length;
+			_gravZ = gz / length;
+		}
+	}
+
+	// reading the current state
+	virtual void GetCalibratedGyro(float& x, float& y, float& z) override
+	{
+		x = _gyroX;
+		y = _gyroY;
+		z = _gyroZ;
+	}
+
+	virtual void GetGravity(float& x, float& y, float& z) override
+	{
+		x = _gravX;
+		y = _gravY;
+		z = _gravZ;
+	}
+
+	virtual void GetProcessedAcceleration(float& x, float& y, float& z) override
+	{
+		x = _accelX + _gravX;
+		y = _accelY + _gravY;
+		z = _accelZ + _gravZ;
+	}
+
+	virtual void GetOrientation(float& w, float& x, float& y, float& z) override
+	{
+		// Shortest rotation from the resting gravity (0, -1, 0) to the current one: tilt only
+		float dot = -_gravY;
+		float axisX = -_gravZ;
+		float axisZ = _gravX;
+		w = 1.f + dot;
+		x = axisX;
+		y = 0.f;
+		z = axisZ;
+		float length = sqrtf(w * w + x * x + z * z);
+		if (length > 0.f)
+		{
+			w /= length;
+			x /= length;
+			z /= length;
+		}
+		else // upside down
+		{
+			w = 0.f;
+			x = 1.f;
+		}
+	}
+
+	// gyro calibration functions
+	virtual void StartContinuousCalibration() override
+	{
+		_calibrating = true;
+	}
+
+	virtual void PauseContinuousCalibration() override
+	{
+		_calibrating = false;
+	}
+
+	virtual void ResetContinuousCalibration() override
+	{
+		_calibrationSumX = 0.;
+		_calibrationSumY = 0.;
+		_calibrationSumZ = 0.;
+		_calibrationCount = 0;
+		_offsetX = 0.f;
+		_offsetY = 0.f;
+		_offsetZ = 0.f;
+	}
+
+	virtual bool IsCalibrating() override
+	{
+		return _calibrating;
+	}
+
+	virtual void GetCalibrationOffset(float& xOffset, float& yOffset, float& zOffset) override
+	{
+		xOffset = _offsetX;
+		yOffset = _offsetY;
+		zOffset = _offsetZ;
+	}
+
+	virtual void SetCalibrationOffset(float xOffset, float yOffset, float zOffset, int weight) override
+	{
+		_calibrationCount = max(weight, 0);
+		_calibrationSumX = double(xOffset) * _calibrationCount;
+		_calibrationSumY = double(yOffset) * _calibrationCount;
+		_calibrationSumZ = double(zOffset) * _calibrationCount;
+		_offsetX = xOffset;
+		_offsetY = yOffset;
+		_offsetZ = zOffset;
+	}
+
+	virtual void SetAutoCalibration(bool enabled, float gyroThreshold, float accelThreshold) override
+	{
+		_autoCalibration = enabled;
+		_gyroThreshold = gyroThreshold;
+		_accelThreshold = accelThreshold;
+	}
+
+	void virtual ResetMotion() override
+	{
+		_gravX = 0.f;
+		_gravY = -1.f;
+		_gravZ = 0.f;
+	}
+};
+
+MotionIf *newComplementaryMotion()
+{
+	return new ComplementaryMotion();
+}
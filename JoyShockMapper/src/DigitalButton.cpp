@@ -9,48 +9,152 @@ void DigitalButton::Context::updateChordStack(bool isPressed, ButtonID id)
 	{
 		if (isPressed)
 		{
-			auto foundChord = find(chordStack.begin(), chordStack.end(), id);
-			if (foundChord == chordStack.end())
-			{
-				// COUT << "Button " << index << " is pressed!\n";
-				chordStack.push_front(id); // Always push at the fromt to make it a stack
-			}
+			// COUT << "Button " << index << " is pressed!\n";
+			chordStack.push(id);
 		}
 		else
 		{
-			auto foundChord = find(chordStack.begin(), chordStack.end(), id);
-			if (foundChord != chordStack.end())
-			{
-				// COUT << "Button " << index << " is released!\n";
-				chordStack.erase(foundChord); // The chord is released
-			}
+			// COUT << "Button " << index << " is released!\n";
+			chordStack.erase(id); // The chord is released
+		}
+	}
+}
+
+void ChordStack::push(ButtonID id)
+{
+	if (!contains(id))
+	{
+		_active.set(index(id));
+		_order[_size++] = id;
+		++_version;
+	}
+}
+
+void ChordStack::erase(ButtonID id)
+{
+	if (contains(id))
+	{
+		_active.reset(index(id));
+		auto found = find(_order.begin(), _order.begin() + _size, id);
+		copy(found + 1, _order.begin() + _size, found);
+		--_size;
+		++_version;
+	}
+}
+
+void DigitalButton::Context::updateGyroModifiers()
+{
+	// Apply gyro modifiers from oldest to newest (thus giving priority to most recent)
+	gyroModifiers = GyroModifiers();
+	for (auto &[id, key] : gyroActions)
+	{
+		switch (key.code)
+		{
+		case GYRO_ON_BIND:
+			gyroModifiers.blockGyro = false;
+			break;
+		case GYRO_OFF_BIND:
+			gyroModifiers.blockGyro = true;
+			break;
+		case GYRO_INV_X:
+			gyroModifiers.invertX = true; // Intentionally don't support multiple inversions
+			break;
+		case GYRO_INV_Y:
+			gyroModifiers.invertY = true;
+			break;
+		case GYRO_INVERT:
+			gyroModifiers.invertX = true;
+			gyroModifiers.invertY = true;
+			break;
+		case GYRO_TRACK_X:
+			gyroModifiers.trackballX = true;
+			break;
+		case GYRO_TRACK_Y:
+			gyroModifiers.trackballY = true;
+			break;
+		case GYRO_TRACKBALL:
+			gyroModifiers.trackballX = true;
+			gyroModifiers.trackballY = true;
+			break;
 		}
 	}
 }
 
+template<typename K>
+static void decrementCount(map<K, int> &counts, const K &key)
+{
+	auto found = counts.find(key);
+	if (--found->second == 0)
+	{
+		counts.erase(found);
+	}
+}
+
+void ActiveKeys::push(ButtonID id, KeyCode key)
+{
+	_entries.push_back({ id, key });
+	_byKey[keyIndex(key)]++;
+	_byButton[id]++;
+	_byEntry[{ id, keyIndex(key) }]++;
+}
+
+bool ActiveKeys::erase(KeyCode key)
+{
+	if (!contains(key))
+	{
+		return false;
+	}
+	_byKey.erase(keyIndex(key));
+	erase_if(_entries, [this, key](const Entry &entry)
+	  {
+		  if (entry.second != key)
+			  return false;
+		  decrementCount(_byButton, entry.first);
+		  decrementCount(_byEntry, { entry.first, keyIndex(key) });
+		  return true;
+	  });
+	return true;
+}
+
+optional<KeyCode> ActiveKeys::oldestOf(ButtonID id) const
+{
+	if (contains(id))
+	{
+		for (auto &entry : _entries)
+		{
+			if (entry.first == id)
+				return entry.second;
+		}
+	}
+	return nullopt;
+}
+
+// Identifies the binding a button activated, from which its name is only built when it gets displayed
+struct PressName
+{
+	ButtonID combo = ButtonID::INVALID; // Other button of a chord, sim, diagonal or double press. NONE for a plain press.
+	char separator = ',';
+	ButtonID button = ButtonID::INVALID;
+};
+
+// Sent between the _buttons of a sim or diagonal press. The receiver moves to nextState, or when it is
+// INVALID, releases its mapping and hands back the state the sender should move to instead.
 struct Sync
 {
-	pocket_fsm::StateIF *nextState = nullptr;
+	BtnState nextState = BtnState::INVALID;
 	chrono::steady_clock::time_point pressTime;
 	const Mapping *activeMapping = nullptr;
-	string nameToRelease;
-	float turboTime;
-	float holdTime;
-	float dblPressWindow;
+	PressName nameToRelease;
+	float turboTime = 0.f;
+	float holdTime = 0.f;
+	float dblPressWindow = 0.f;
 };
 
 // Hidden implementation of the digital button
-// This class holds all the logic related to a single digital button. It does not hold the mapping but only a reference
-// to it. It also contains its various states, flags and data. The concrete state of the state machine hands off the
-// instance to the next state, and so is persistent across states
-struct DigitalButtonImpl : public pocket_fsm::PimplBase, public EventActionIf
+// This class holds the actions and data of a single digital button. It does not hold the mapping but only a reference
+// to it. The state machine itself lives in DigitalButton, and this data persists across its states.
+struct DigitalButtonImpl : public EventActionIf
 {
-private:
-	static bool isSameKey(KeyCode key, const pair<ButtonID, KeyCode> &pair)
-	{
-		return pair.second == key;
-	};
-
 public:
 	multimap<BtnEvent, Callback> _instantReleaseQueue;
 	unsigned int _turboApplies = 0;
@@ -66,10 +170,11 @@ public:
 	}
 
 	const ButtonID _id; // Always ID first for easy debugging
-	string _nameToRelease;
+	PressName _nameToRelease;
+	string _displayName; // Built from _nameToRelease, reusing its storage
 	shared_ptr<DigitalButton::Context> _context;
 	chrono::steady_clock::time_point _press_times;
-	optional<Mapping> _keyToRelease; // At key press, remember what to release
+	optional<Mapping> _keyToRelease; // At key press, remember what to release. Copying a mapping only shares its binding.
 	const JSMButton &_mapping;
 	DigitalButton *_masterPress = nullptr; // Who is this button's master in either sim or diag presses
 
@@ -81,19 +186,14 @@ public:
 
 	bool HasActiveToggle(shared_ptr<DigitalButton::Context> _context, const KeyCode &key) const
 	{
-		auto foundToggle = find_if(_context->activeTogglesQueue.cbegin(), _context->activeTogglesQueue.cend(),
-		  [key](auto &pair)
-		  {
-			  return pair.second == key;
-		  });
-		return foundToggle != _context->activeTogglesQueue.cend();
+		return _context->activeToggles.contains(key);
 	}
 
 	void ClearKey()
 	{
 		_keyToRelease = nullopt;
 		_instantReleaseQueue.clear();
-		_nameToRelease.clear();
+		_nameToRelease = PressName();
 		_turboApplies = 0;
 		_turboReleases = 0;
 	}
@@ -110,18 +210,18 @@ public:
 		return true;
 	}
 
-	optional<Mapping> GetPressMapping()
+	const optional<Mapping> &GetPressMapping()
 	{
 		if (!_keyToRelease)
 		{
 			// Look at active chord mappings starting with the latest activates chord
-			for (auto activeChord = _context->chordStack.cbegin(); activeChord != _context->chordStack.cend(); activeChord++)
+			for (auto activeChord = _context->chordStack.begin(); activeChord != _context->chordStack.end(); activeChord++)
 			{
 				auto binding = _mapping.chordedValue(*activeChord);
 				if (binding && *activeChord != _id)
 				{
 					_keyToRelease = *binding;
-					_nameToRelease = _mapping.getName(*activeChord);
+					_nameToRelease = { *activeChord, ',', _id };
 					return _keyToRelease;
 				}
 			}
@@ -142,35 +242,43 @@ public:
 
 	void ApplyGyroAction(KeyCode gyroAction) override
 	{
-		_context->gyroActionQueue.push_back({ _id, gyroAction });
+		_context->gyroActions.push(_id, gyroAction);
+		_context->updateGyroModifiers();
+		Trace("gyro on", gyroAction.name());
 	}
 
 	void RemoveGyroAction() override
 	{
-		auto gyroAction = find_if(_context->gyroActionQueue.begin(), _context->gyroActionQueue.end(),
-		  [this](auto pair)
-		  {
-			  // On a sim press, release the master button (the one who triggered the press)
-			  return pair.first == (_masterPress ? _masterPress->_id : _id);
-		  });
-		if (gyroAction != _context->gyroActionQueue.end())
+		// On a sim press, release the master button (the one who triggered the press)
+		auto key = _context->gyroActions.oldestOf(_masterPress ? _masterPress->_id : _id);
+		if (key)
 		{
-			KeyCode key(gyroAction->second);
-			ClearAllActiveToggle(key);
-			for (auto currentlyActive = find_if(_context->gyroActionQueue.begin(), _context->gyroActionQueue.end(), bind(isSameKey, key, placeholders::_1));
-			     currentlyActive != _context->gyroActionQueue.end();
-			     currentlyActive = find_if(currentlyActive, _context->gyroActionQueue.end(), bind(isSameKey, key, placeholders::_1)))
-			{
-				// DEBUG_LOG << "Removing active gyro action for " << key.name << endl;
-				currentlyActive = _context->gyroActionQueue.erase(currentlyActive);
-			}
+			ClearAllActiveToggle(*key);
+			// DEBUG_LOG << "Removing active gyro action for " << key->name() << endl;
+			_context->gyroActions.erase(*key);
+			_context->updateGyroModifiers();
+			Trace("gyro off", key->name());
+		}
+	}
+
+	// When replaying recorded input, hand the output to the trace instead of performing it
+	bool Trace(string_view action, string_view key)
+	{
+		if (_context->_trace)
+		{
+			_context->_trace(_id, action, key);
+			return true;
 		}
+		return false;
 	}
 
 	void SetRumble(int smallRumble, int bigRumble) override
 	{
 		DEBUG_LOG << "Rumbling at " << smallRumble << " and " << bigRumble << '\n';
-		_context->_rumble(smallRumble, bigRumble);
+		if (_context->_trace)
+			Trace("rumble", to_string(smallRumble) + ',' + to_string(bigRumble));
+		else
+			_context->_rumble(smallRumble, bigRumble);
 	}
 
 	void ApplyBtnPress(KeyCode key) override
@@ -178,7 +286,7 @@ public:
 		if (key.code >= X_UP && key.code <= X_START || key.code == PS_HOME || 
 			key.code == PS_PAD_CLICK || key.code == X_LT || key.code == X_RT)
 		{
-			if (_context->_vigemController)
+			if (!Trace("press", key.name()) && _context->_vigemController)
 				_context->_vigemController->setButton(key, true);
 		}
 		else if (key.code == VK_NONAME)
@@ -188,9 +296,10 @@ public:
 		}
 		else if (key.code != NO_HOLD_MAPPED && HasActiveToggle(_context, key) == false)
 		{
-			pressKey(key, true);
+			if (!Trace("press", key.name()))
+				pressKey(key, true);
 		}
-		DEBUG_LOG << "Pressing down on key " << key.name << endl;
+		DEBUG_LOG << "Pressing down on key " << key.name() << endl;
 	}
 
 	void ApplyBtnRelease(KeyCode key) override
@@ -198,7 +307,11 @@ public:
 		if (key.code >= X_UP && key.code <= X_START || key.code == PS_HOME ||
 			key.code == PS_PAD_CLICK || key.code == X_LT || key.code == X_RT)
 		{
-			if (_context->_vigemController)
+			if (Trace("release", key.name()))
+			{
+				ClearAllActiveToggle(key);
+			}
+			else if (_context->_vigemController)
 			{
 				_context->_vigemController->setButton(key, false);
 				ClearAllActiveToggle(key);
@@ -206,24 +319,20 @@ public:
 		}
 		else if (key.code != NO_HOLD_MAPPED)
 		{
-			pressKey(key, false);
+			if (!Trace("release", key.name()))
+				pressKey(key, false);
 			ClearAllActiveToggle(key);
 		}
-		DEBUG_LOG << "Releasing key " << key.name << endl;
+		DEBUG_LOG << "Releasing key " << key.name() << endl;
 	}
 
 	void ApplyButtonToggle(KeyCode key, EventActionIf::Callback apply, EventActionIf::Callback release) override
 	{
-		auto currentlyActive = find_if(_context->activeTogglesQueue.begin(), _context->activeTogglesQueue.end(),
-		  [this, key](pair<ButtonID, KeyCode> pair)
-		  {
-			  return pair.first == _id && pair.second == key;
-		  });
-		if (currentlyActive == _context->activeTogglesQueue.end())
+		if (!_context->activeToggles.contains(_id, key))
 		{
-			DEBUG_LOG << "Adding active toggle for " << key.name << '\n';
+			DEBUG_LOG << "Adding active toggle for " << key.name() << '\n';
 			apply(this);
-			_context->activeTogglesQueue.push_front({ _id, key });
+			_context->activeToggles.push(_id, key);
 		}
 		else
 		{
@@ -233,17 +342,16 @@ public:
 
 	void ClearAllActiveToggle(KeyCode key)
 	{
-		for (auto currentlyActive = find_if(_context->activeTogglesQueue.begin(), _context->activeTogglesQueue.end(), bind(isSameKey, key, placeholders::_1));
-		     currentlyActive != _context->activeTogglesQueue.end();
-		     currentlyActive = find_if(currentlyActive, _context->activeTogglesQueue.end(), bind(isSameKey, key, placeholders::_1)))
+		if (_context->activeToggles.erase(key))
 		{
-			DEBUG_LOG << "Removing active toggle for " << key.name << '\n';
-			currentlyActive = _context->activeTogglesQueue.erase(currentlyActive);
+			DEBUG_LOG << "Removing active toggle for " << key.name() << '\n';
 		}
 	}
 
 	void StartCalibration() override
 	{
+		if (Trace("calibration", "start"))
+			return;
 		COUT << "Starting continuous calibration\n";
 		_context->rightMainMotion->ResetContinuousCalibration();
 		_context->rightMainMotion->StartContinuousCalibration();
@@ -257,796 +365,768 @@ public:
 
 	void FinishCalibration() override
 	{
-		_context->rightMainMotion->PauseContinuousCalibration();
-		if (_context->leftMotion)
+		if (!Trace("calibration", "finish"))
 		{
-			// Perform calibration on both gyros of a joycon pair regardless of mask
-			_context->leftMotion->PauseContinuousCalibration();
+			_context->rightMainMotion->PauseContinuousCalibration();
+			if (_context->leftMotion)
+			{
+				// Perform calibration on both gyros of a joycon pair regardless of mask
+				_context->leftMotion->PauseContinuousCalibration();
+			}
+			COUT << "Gyro calibration set\n";
 		}
-		COUT << "Gyro calibration set\n";
-		ClearAllActiveToggle(KeyCode("CALIBRATE"));
+		static const KeyCode calibrate("CALIBRATE");
+		ClearAllActiveToggle(calibrate);
+	}
+
+	void RunCommand(KeyCode command) override
+	{
+		if (!Trace("command", command.name()))
+			WriteToConsole(command.name());
 	}
 
 	const char *getDisplayName() override
 	{
-		return _nameToRelease.c_str();
+		_displayName.clear();
+		if (_nameToRelease.button != ButtonID::INVALID)
+		{
+			if (_nameToRelease.combo > ButtonID::NONE)
+			{
+				_displayName += buttonName(_nameToRelease.combo);
+				_displayName += _nameToRelease.separator;
+			}
+			_displayName += buttonName(_nameToRelease.button);
+		}
+		return _displayName.c_str();
 	}
 };
 
-// Forward declare concrete states
-class NoPress;
-class BtnPress;
-class TapPress;
-class WaitSim;
-class SimPressMaster;
-class SimPressSlave;
-class SimRelease;
-class DiagPressSlave;
-class DiagRelease;
-class DblPressStart;
-class DblPressNoPress;
-class DblPressNoPressTap;
-class DblPressNoPressHold;
-class DblPressPress;
-class InstRelease;
-
-// Forward declare concrete nested states
-class ActiveStartPress;
-class ActiveHoldPress;
-
-// Basic state react
-void DigitalButtonState::react(OnEntry &e)
-{
-	// Uncomment below to diplay a log each time a button changes state
-	// DEBUG_LOG << "Button " << pimpl()->_id << " is now in state " << _name << '\n';
-}
-
-// Basic Press reaction should be called in every concrete Press reaction
-void DigitalButtonState::react(Pressed &e)
+const array<DigitalButton::StateHandlers, size_t(BtnState::INVALID)> DigitalButton::STATE_HANDLERS = []()
 {
-	pimpl()->_context->updateChordStack(true, pimpl()->_id);
-}
-
-// Basic Release reaction should be called in every concrete Release reaction
-void DigitalButtonState::react(Released &e)
+	array<StateHandlers, size_t(BtnState::INVALID)> handlers;
+	handlers.fill({ &DigitalButton::ignore, &DigitalButton::ignore, &DigitalButton::basePressed, &DigitalButton::baseReleased, &DigitalButton::ignoreSync });
+	// States with a nested active mapping forward the events to it
+	StateHandlers active{ &DigitalButton::activeEntry, &DigitalButton::ignore, &DigitalButton::activePressed, &DigitalButton::activeReleased, &DigitalButton::activeSync };
+	handlers[size_t(BtnState::NoPress)].pressed = &DigitalButton::noPressPressed;
+	handlers[size_t(BtnState::BtnPress)] = active;
+	handlers[size_t(BtnState::TapPress)] = { &DigitalButton::tapPressEntry, &DigitalButton::tapPressExit, &DigitalButton::tapPressPressed, &DigitalButton::tapPressReleased, &DigitalButton::ignoreSync };
+	handlers[size_t(BtnState::WaitSim)] = { &DigitalButton::ignore, &DigitalButton::ignore, &DigitalButton::waitSimPressed, &DigitalButton::waitSimReleased, &DigitalButton::waitSimSync };
+	handlers[size_t(BtnState::SimPressMaster)] = active;
+	handlers[size_t(BtnState::SimPressSlave)].pressed = &DigitalButton::simPressSlavePressed;
+	handlers[size_t(BtnState::SimPressSlave)].released = &DigitalButton::simPressSlaveReleased;
+	handlers[size_t(BtnState::SimRelease)].released = &DigitalButton::simReleaseReleased;
+	handlers[size_t(BtnState::SimRelease)].sync = &DigitalButton::simReleaseSync;
+	handlers[size_t(BtnState::DiagPressMaster)] = active;
+	handlers[size_t(BtnState::DiagPressSlave)].pressed = &DigitalButton::diagPressSlavePressed;
+	handlers[size_t(BtnState::DiagPressSlave)].released = &DigitalButton::diagPressSlaveReleased;
+	handlers[size_t(BtnState::DblPressStart)] = { &DigitalButton::activeEntry, &DigitalButton::ignore, &DigitalButton::activePressed, &DigitalButton::dblPressStartReleased, &DigitalButton::ignoreSync };
+	handlers[size_t(BtnState::DblPressNoPress)].pressed = &DigitalButton::dblPressNoPressPressed;
+	handlers[size_t(BtnState::DblPressNoPress)].released = &DigitalButton::dblPressNoPressReleased;
+	handlers[size_t(BtnState::DblPressNoPressTap)].pressed = &DigitalButton::dblPressNoPressTapPressed;
+	handlers[size_t(BtnState::DblPressNoPressTap)].released = &DigitalButton::dblPressNoPressTapReleased;
+	handlers[size_t(BtnState::DblPressNoPressHold)].pressed = &DigitalButton::dblPressNoPressHoldPressed;
+	handlers[size_t(BtnState::DblPressNoPressHold)].released = &DigitalButton::dblPressNoPressHoldReleased;
+	handlers[size_t(BtnState::DblPressPress)] = { &DigitalButton::dblPressPressEntry, &DigitalButton::ignore, &DigitalButton::activePressed, &DigitalButton::activeReleased, &DigitalButton::ignoreSync };
+	handlers[size_t(BtnState::InstRelease)].pressed = &DigitalButton::instReleasePressed;
+	handlers[size_t(BtnState::InstRelease)].released = &DigitalButton::instReleaseReleased;
+	return handlers;
+}();
+
+void DigitalButton::sendEvent(const Pressed &e)
 {
-	pimpl()->_context->updateChordStack(false, pimpl()->_id);
+	_lastEvent = { e.time_now, e.turboTime, e.holdTime, e.dblPressWindow };
+	_lastPressed = true;
+	(this->*STATE_HANDLERS[size_t(_state)].pressed)(e);
+	commitState(e.time_now);
 }
 
-void DigitalButtonState::react(chrono::steady_clock::time_point &e)
+void DigitalButton::sendEvent(const Released &e)
 {
-	// final implementation. All states can be assigned a new press time
-	pimpl()->_press_times = e;
+	_lastEvent = e;
+	_lastPressed = false;
+	(this->*STATE_HANDLERS[size_t(_state)].released)(e);
+	commitState(e.time_now);
 }
 
-void DigitalButtonState::react(GetDuration &e)
+void DigitalButton::fireDeadline(chrono::steady_clock::time_point now, optional<bool> pressedNow)
 {
-	// final implementation. All states can be querried it's duration time.
-	e.out_duration = pimpl()->GetPressDurationMS(e.in_now);
-}
-
+	if (!_deadline || *_deadline > now)
+		return;
 
-// Append to pocket_fsm macro
-#define DB_CONCRETE_STATE(statename)           \
-	CONCRETE_STATE(statename)                  \
-	virtual BtnState getState() const override \
-	{                                          \
-		return BtnState::statename;            \
+	if (pressedNow && *pressedNow != _lastPressed)
+	{
+		// Replaying the input would hold or turbo a button that is already up. The deadline is
+		// recomputed when the poll sends the change.
+		_deadline = nullopt;
+		return;
 	}
 
-// Base state for all nested states in which a mapping is active
-class ActiveMappingState : public DigitalButtonState
-{
-public:
-	virtual BtnState getState() const override
+	if (_lastPressed)
 	{
-		return BtnState::INVALID;
+		sendEvent(Pressed{ now, _lastEvent.turboTime, _lastEvent.holdTime, _lastEvent.dblPressWindow });
 	}
-
-	REACT(Released)
-	override
+	else
 	{
-		DigitalButtonState::react(e);
-		pimpl()->_keyToRelease->ProcessEvent(BtnEvent::OnRelease, *pimpl());
+		sendEvent(Released{ now, _lastEvent.turboTime, _lastEvent.holdTime, _lastEvent.dblPressWindow });
 	}
+}
 
-	REACT(Sync)
-	final
+void DigitalButton::updateDeadline(chrono::steady_clock::time_point now)
+{
+	auto pressTime = _impl->_press_times;
+	auto earliest = chrono::steady_clock::time_point::max();
+	// The reactions compare whole milliseconds with the duration, so the deadline is the millisecond after it
+	auto consider = [pressTime, now, &earliest](float duration)
 	{
-		Released rel{ e.pressTime, e.turboTime, e.holdTime };
-		react(rel);
-		// Redirect change of state to the caller of the Sync
-		if (e.nextState == nullptr)
+		auto deadline = pressTime + chrono::milliseconds(int(floorf(duration)) + 1);
+		if (deadline > now && deadline < earliest)
+			earliest = deadline;
+	};
+	bool hasInstants = !_impl->_instantReleaseQueue.empty();
+	switch (_state)
+	{
+	case BtnState::BtnPress:
+	case BtnState::SimPressMaster:
+	case BtnState::DiagPressMaster:
+	case BtnState::DblPressStart:
+	case BtnState::DblPressPress:
+		if (_activeState == ActiveState::StartPress)
 		{
-			// Release from SimPress
-
-			e.nextState = _nextState;
-			_nextState = nullptr;
-			changeState<SimRelease>();
+			if (hasInstants)
+				consider(MAGIC_INSTANT_DURATION);
+			consider(_lastEvent.holdTime);
 		}
 		else
 		{
-			if (e.activeMapping != nullptr)
-			{
-				// Activate Diagonal
-				// DEBUG_LOG << "Button " << pimpl()->_id << " enables active diagonal as master\n";
-				pimpl()->_masterPress = nullptr;
-				pimpl()->_keyToRelease = *e.activeMapping;
-				pimpl()->_nameToRelease = e.nameToRelease;
-			}
-			else // release diagonal
+			if (hasInstants)
+				consider(_lastEvent.holdTime + MAGIC_INSTANT_DURATION);
+			if (_lastEvent.turboTime > 0.f)
 			{
-				// DEBUG_LOG << "Button " << pimpl()->_id << " releases active diagonal\n";
-				pimpl()->ClearKey();
+				consider(_lastEvent.holdTime + _impl->_turboApplies * _lastEvent.turboTime);
+				if (hasInstants)
+					consider(_lastEvent.holdTime + _impl->_turboReleases * _lastEvent.turboTime + MAGIC_INSTANT_DURATION);
 			}
-			pimpl()->_press_times = e.pressTime;
-			delete _nextState;
-			_nextState = e.nextState;
 		}
+		break;
+	case BtnState::TapPress:
+		if (hasInstants)
+			consider(MAGIC_INSTANT_DURATION);
+		if (_impl->_keyToRelease)
+			consider(_impl->_keyToRelease->getTapDuration());
+		break;
+	case BtnState::WaitSim:
+		consider(SettingsManager::getV<float>(SettingID::SIM_PRESS_WINDOW)->value());
+		break;
+	case BtnState::DblPressNoPress:
+		if (hasInstants)
+			consider(MAGIC_INSTANT_DURATION);
+		consider(_lastEvent.dblPressWindow);
+		break;
+	case BtnState::DblPressNoPressTap:
+	case BtnState::DblPressNoPressHold:
+		consider(_lastEvent.dblPressWindow);
+		break;
+	case BtnState::InstRelease:
+		consider(MAGIC_INSTANT_DURATION);
+		break;
+	default:
+		// The other states only progress with a change of input
+		break;
 	}
-};
-
-// Nested concrete states
 
-class ActiveStartPress : public ActiveMappingState
-{
-	CONCRETE_STATE(ActiveStartPress)
-	INITIAL_STATE(ActiveStartPress)
-
-	REACT(OnEntry)
-	override
+	if (earliest == chrono::steady_clock::time_point::max())
 	{
-		DigitalButtonState::react(e);
-		pimpl()->GetPressMapping()->ProcessEvent(BtnEvent::OnPress, *pimpl());
+		_deadline = nullopt;
 	}
-
-	REACT(Pressed)
-	override
+	else
 	{
-		DigitalButtonState::react(e);
-
-		auto elapsed_time = pimpl()->GetPressDurationMS(e.time_now);
-		if (elapsed_time > MAGIC_INSTANT_DURATION)
-		{
-			pimpl()->ReleaseInstant(BtnEvent::OnPress);
-		}
-		if (elapsed_time > e.holdTime)
-		{
-			changeState<ActiveHoldPress>();
-		}
+		_deadline = earliest;
+		_impl->_context->scheduleDeadline(earliest);
 	}
+}
 
-	REACT(Released)
-	override
-	{
-		ActiveMappingState::react(e);
-		pimpl()->_press_times = e.time_now; // Start counting tap duration
-		changeState<TapPress>();
-	}
+void DigitalButton::sendEvent(SetPressTime e)
+{
+	// All states can be assigned a new press time
+	_impl->_press_times = e;
+}
 
-};
+GetDuration &DigitalButton::sendEvent(GetDuration &e)
+{
+	// All states can be querried it's duration time.
+	e.out_duration = _impl->GetPressDurationMS(e.in_now);
+	return e;
+}
 
-class ActiveHoldPress : public ActiveMappingState
+bool DigitalButton::isIdle() const
 {
-	CONCRETE_STATE(ActiveHoldPress)
+	// The chord of a button can outlive its press, like when a diagonal slave is sent back to NoPress
+	return _state == BtnState::NoPress && !_impl->_context->chordStack.contains(_id);
+}
 
-	REACT(OnEntry)
-	override
-	{
-		DigitalButtonState::react(e);
-		pimpl()->_keyToRelease->ProcessEvent(BtnEvent::OnHold, *pimpl());
-		pimpl()->_keyToRelease->ProcessEvent(BtnEvent::OnTurbo, *pimpl());
-		pimpl()->_turboApplies++;
-	}
+const JSMButton &DigitalButton::getMapping() const
+{
+	return _impl->_mapping;
+}
 
-	REACT(Pressed)
-	override
-	{
-		auto elapsed_time = pimpl()->GetPressDurationMS(e.time_now);
-		if (elapsed_time > e.holdTime + MAGIC_INSTANT_DURATION)
-		{
-			pimpl()->ReleaseInstant(BtnEvent::OnHold);
-		}
-		if (floorf((elapsed_time - e.holdTime) / e.turboTime) >= pimpl()->_turboApplies)
-		{
-			pimpl()->_keyToRelease->ProcessEvent(BtnEvent::OnTurbo, *pimpl());
-			pimpl()->_turboApplies++;
-		}
-		if (elapsed_time > e.holdTime + pimpl()->_turboReleases * e.turboTime + MAGIC_INSTANT_DURATION)
-		{
-			pimpl()->ReleaseInstant(BtnEvent::OnTurbo);
-			pimpl()->_turboReleases++;
-		}
-	}
+Sync &DigitalButton::sendEvent(Sync &e)
+{
+	(this->*STATE_HANDLERS[size_t(_state)].sync)(e);
+	commitState(e.pressTime);
+	return e;
+}
 
-	REACT(Released)
-	override
+void DigitalButton::commitState(chrono::steady_clock::time_point now)
+{
+	while (_nextState != BtnState::INVALID)
 	{
-		ActiveMappingState::react(e);
-		pimpl()->_keyToRelease->ProcessEvent(BtnEvent::OnHoldRelease, *pimpl());
-		if (pimpl()->_instantReleaseQueue.empty())
-		{
-			changeState<NoPress>();
-			pimpl()->ClearKey();
-		}
-		else
-		{
-			changeState<InstRelease>();
-			pimpl()->_press_times = e.time_now; // Start counting tap duration
-		}
+		(this->*STATE_HANDLERS[size_t(_state)].onExit)();
+		_state = exchange(_nextState, BtnState::INVALID);
+		// Uncomment below to diplay a log each time a button changes state
+		// DEBUG_LOG << "Button " << _id << " is now in state " << _state << '\n';
+		(this->*STATE_HANDLERS[size_t(_state)].onEntry)();
 	}
-};
+	updateDeadline(now);
+}
 
-class DiagPressMaster : public pocket_fsm::NestedStateMachine<ActiveMappingState, DigitalButtonState>
+// Basic Press reaction should be called in every concrete Press reaction
+void DigitalButton::basePressed(const Pressed &e)
 {
-	DB_CONCRETE_STATE(DiagPressMaster)
+	_impl->_context->updateChordStack(true, _id);
+}
 
-	REACT(OnEntry)
-	override
+// Basic Release reaction should be called in every concrete Release reaction
+void DigitalButton::baseReleased(const Released &e)
+{
+	_impl->_context->updateChordStack(false, _id);
+}
+
+// Make this button the slave of a diagonal press with every matching button that is pressed
+void DigitalButton::startDiagonalPress(const Pressed &e)
+{
+	size_t counter = 0;
+	size_t diag = 0;
+	ComboPartner partner;
+	for (auto btn = _impl->_context->_getMatchingDiagBtn(_id, diag, partner); btn;
+	     btn = _impl->_context->_getMatchingDiagBtn(_id, ++diag, partner))
 	{
-		DigitalButtonState::react(e);
-		initialize(new ActiveStartPress(_pimpl));
+		// DEBUG_LOG << "Button " << _id << " enables diagonal press with " << btn->_id << " who is in state " << btn->getState() << '\n';
+		_impl->_masterPress = btn;
+		_impl->_nameToRelease = { partner.id, '*', _id };
+		_impl->_keyToRelease = partner.mapping->value();
+		Sync sync;
+		sync.nameToRelease = _impl->_nameToRelease;
+		sync.activeMapping = &*_impl->_keyToRelease;
+		sync.pressTime = e.time_now;
+		sync.holdTime = e.holdTime;
+		sync.turboTime = e.turboTime;
+		sync.dblPressWindow = e.dblPressWindow;
+		sync.nextState = BtnState::DiagPressMaster;
+		_impl->_masterPress->sendEvent(sync);
+		counter++;
 	}
 
-	NESTED_REACT(Pressed)
-
-	NESTED_REACT(Released)
+	if (counter > 0)
+		changeState(BtnState::DiagPressSlave);
+	else
+		changeState(BtnState::BtnPress);
+}
 
-	NESTED_REACT(Sync)
+// States in which a mapping is active: BtnPress, SimPressMaster, DiagPressMaster, DblPressStart and DblPressPress.
+// They all start with the nested StartPress state and forward the events to their nested state.
 
-	void swapPimpl(DigitalButtonState &otherState) override
-	{
-		_currentState->resetPimpl(otherState);
-		DigitalButtonState::swapPimpl(otherState);
-	}
-};
+void DigitalButton::activeEntry()
+{
+	_activeState = ActiveState::StartPress;
+	startPressEntry();
+}
 
-// Core concrete states
+void DigitalButton::activePressed(const Pressed &e)
+{
+	if (_activeState == ActiveState::StartPress)
+		startPressPressed(e);
+	else
+		holdPressPressed(e);
+}
 
-class NoPress : public DigitalButtonState
+void DigitalButton::activeReleased(const Released &e)
 {
-	DB_CONCRETE_STATE(NoPress)
-	INITIAL_STATE(NoPress)
+	if (_activeState == ActiveState::StartPress)
+		startPressReleased(e);
+	else
+		holdPressReleased(e);
+}
 
-	REACT(Pressed)
-	override
+void DigitalButton::activeSync(Sync &e)
+{
+	Released rel{ e.pressTime, e.turboTime, e.holdTime };
+	activeReleased(rel);
+	// Redirect change of state to the caller of the Sync
+	if (e.nextState == BtnState::INVALID)
 	{
-		DigitalButtonState::react(e);
-		pimpl()->_press_times = e.time_now;
-		if (pimpl()->_mapping.hasSimMappings() && pimpl()->GetPressDurationMS(e.time_now) < SettingsManager::getV<float>(SettingID::SIM_PRESS_WINDOW)->value())
-		{
-			changeState<WaitSim>();
-		}
-		else if (pimpl()->_mapping.getDblPressMap())
-		{
-			// Start counting time between two start presses
-			changeState<DblPressStart>();
-		}
-		else if (pimpl()->_mapping.hasDiagMappings())
+		// Release from SimPress
+		e.nextState = _nextState;
+		changeState(BtnState::SimRelease);
+	}
+	else
+	{
+		if (e.activeMapping != nullptr)
 		{
-			size_t counter = 0;
-			optional<MapIterator> diag = nullopt;
-			for (auto btn = pimpl()->_context->_getMatchingDiagBtn(pimpl()->_id, diag); btn;
-				 btn = pimpl()->_context->_getMatchingDiagBtn(pimpl()->_id, diag))
-			{
-				// DEBUG_LOG << "Button " << pimpl()->_id << " enables diagonal press with " << btn->_id << " who is in state " << btn->getCurrentStateName() << '\n';
-				pimpl()->_masterPress = btn;
-				pimpl()->_nameToRelease = pimpl()->_mapping.getDiagPressName((*diag)->first);
-				pimpl()->_keyToRelease = (*diag)->second.value();
-				Sync sync;
-				sync.nameToRelease = pimpl()->_nameToRelease;
-				sync.activeMapping = &*pimpl()->_keyToRelease;
-				sync.pressTime = e.time_now;
-				sync.holdTime = e.holdTime;
-				sync.turboTime = e.turboTime;
-				sync.dblPressWindow = e.dblPressWindow;
-				sync.nextState = new DiagPressMaster();
-				pimpl()->_masterPress->sendEvent(sync);
-				++*diag;
-				counter++;
-			}
-
-			if (counter > 0 )
-				changeState<DiagPressSlave>();
-			else
-				changeState<BtnPress>();
+			// Activate Diagonal
+			// DEBUG_LOG << "Button " << _id << " enables active diagonal as master\n";
+			_impl->_masterPress = nullptr;
+			_impl->_keyToRelease = *e.activeMapping;
+			_impl->_nameToRelease = e.nameToRelease;
 		}
-		else
+		else // release diagonal
 		{
-			changeState<BtnPress>();
+			// DEBUG_LOG << "Button " << _id << " releases active diagonal\n";
+			_impl->ClearKey();
 		}
+		_impl->_press_times = e.pressTime;
+		changeState(e.nextState);
 	}
-};
+}
+
+void DigitalButton::activeMappingReleased(const Released &e)
+{
+	baseReleased(e);
+	_impl->_keyToRelease->ProcessEvent(BtnEvent::OnRelease, *_impl);
+}
+
+void DigitalButton::startPressEntry()
+{
+	_impl->GetPressMapping()->ProcessEvent(BtnEvent::OnPress, *_impl);
+}
 
-class BtnPress : public pocket_fsm::NestedStateMachine<ActiveMappingState, DigitalButtonState>
+void DigitalButton::startPressPressed(const Pressed &e)
 {
-	DB_CONCRETE_STATE(BtnPress)
+	basePressed(e);
 
-	REACT(OnEntry)
-	override
+	auto elapsed_time = _impl->GetPressDurationMS(e.time_now);
+	if (elapsed_time > MAGIC_INSTANT_DURATION)
+	{
+		_impl->ReleaseInstant(BtnEvent::OnPress);
+	}
+	if (elapsed_time > e.holdTime)
 	{
-		DigitalButtonState::react(e);
-		initialize(new ActiveStartPress(_pimpl));
+		_activeState = ActiveState::HoldPress;
+		holdPressEntry();
 	}
+}
 
-	NESTED_REACT(Pressed);
-	NESTED_REACT(Released);
-	NESTED_REACT(Sync);
-};
+void DigitalButton::startPressReleased(const Released &e)
+{
+	activeMappingReleased(e);
+	_impl->_press_times = e.time_now; // Start counting tap duration
+	changeState(BtnState::TapPress);
+}
 
-class TapPress : public DigitalButtonState
+void DigitalButton::holdPressEntry()
 {
-	DB_CONCRETE_STATE(TapPress)
+	_impl->_keyToRelease->ProcessEvent(BtnEvent::OnHold, *_impl);
+	_impl->_keyToRelease->ProcessEvent(BtnEvent::OnTurbo, *_impl);
+	_impl->_turboApplies++;
+}
 
-	REACT(OnEntry)
-	override
+void DigitalButton::holdPressPressed(const Pressed &e)
+{
+	auto elapsed_time = _impl->GetPressDurationMS(e.time_now);
+	if (elapsed_time > e.holdTime + MAGIC_INSTANT_DURATION)
 	{
-		pimpl()->_keyToRelease->ProcessEvent(BtnEvent::OnTap, *pimpl());
+		_impl->ReleaseInstant(BtnEvent::OnHold);
 	}
-
-	REACT(Pressed)
-	override
+	if (floorf((elapsed_time - e.holdTime) / e.turboTime) >= _impl->_turboApplies)
 	{
-		DigitalButtonState::react(e);
-		pimpl()->ReleaseInstant(BtnEvent::OnRelease);
-		pimpl()->ReleaseInstant(BtnEvent::OnTap);
-		changeState<BtnPress>();
+		_impl->_keyToRelease->ProcessEvent(BtnEvent::OnTurbo, *_impl);
+		_impl->_turboApplies++;
 	}
-
-	REACT(Released)
-	override
+	if (elapsed_time > e.holdTime + _impl->_turboReleases * e.turboTime + MAGIC_INSTANT_DURATION)
 	{
-		DigitalButtonState::react(e);
-		if (pimpl()->GetPressDurationMS(e.time_now) > MAGIC_INSTANT_DURATION)
-		{
-			pimpl()->ReleaseInstant(BtnEvent::OnRelease);
-			pimpl()->ReleaseInstant(BtnEvent::OnTap);
-		}
-		if (!pimpl()->_keyToRelease || pimpl()->GetPressDurationMS(e.time_now) > pimpl()->_keyToRelease->getTapDuration())
-		{
-			changeState<NoPress>();
-		}
+		_impl->ReleaseInstant(BtnEvent::OnTurbo);
+		_impl->_turboReleases++;
 	}
+}
 
-	REACT(OnExit)
-	override
+void DigitalButton::holdPressReleased(const Released &e)
+{
+	activeMappingReleased(e);
+	_impl->_keyToRelease->ProcessEvent(BtnEvent::OnHoldRelease, *_impl);
+	if (_impl->_instantReleaseQueue.empty())
 	{
-		pimpl()->_keyToRelease->ProcessEvent(BtnEvent::OnTapRelease, *pimpl());
-		pimpl()->ClearKey();
+		changeState(BtnState::NoPress);
+		_impl->ClearKey();
 	}
-};
+	else
+	{
+		changeState(BtnState::InstRelease);
+		_impl->_press_times = e.time_now; // Start counting tap duration
+	}
+}
 
-class SimPressMaster : public pocket_fsm::NestedStateMachine<ActiveMappingState, DigitalButtonState>
-{
-	DB_CONCRETE_STATE(SimPressMaster)
+// Core states
 
-	REACT(OnEntry)
-	override
+void DigitalButton::noPressPressed(const Pressed &e)
+{
+	basePressed(e);
+	_impl->_press_times = e.time_now;
+	if (_impl->_mapping.hasSimMappings() && _impl->GetPressDurationMS(e.time_now) < SettingsManager::getV<float>(SettingID::SIM_PRESS_WINDOW)->value())
 	{
-		DigitalButtonState::react(e);
-		initialize(new ActiveStartPress(_pimpl));
+		changeState(BtnState::WaitSim);
 	}
+	else if (_impl->_mapping.getDblPressMap())
+	{
+		// Start counting time between two start presses
+		changeState(BtnState::DblPressStart);
+	}
+	else if (_impl->_mapping.hasDiagMappings())
+	{
+		startDiagonalPress(e);
+	}
+	else
+	{
+		changeState(BtnState::BtnPress);
+	}
+}
 
-	NESTED_REACT(Pressed)
-
-	NESTED_REACT(Released)
+void DigitalButton::tapPressEntry()
+{
+	_impl->_keyToRelease->ProcessEvent(BtnEvent::OnTap, *_impl);
+}
 
-	NESTED_REACT(Sync)
-};
+void DigitalButton::tapPressExit()
+{
+	_impl->_keyToRelease->ProcessEvent(BtnEvent::OnTapRelease, *_impl);
+	_impl->ClearKey();
+}
 
-class SimPressSlave : public DigitalButtonState
+void DigitalButton::tapPressPressed(const Pressed &e)
 {
-	DB_CONCRETE_STATE(SimPressSlave)
+	basePressed(e);
+	_impl->ReleaseInstant(BtnEvent::OnRelease);
+	_impl->ReleaseInstant(BtnEvent::OnTap);
+	changeState(BtnState::BtnPress);
+}
 
-	REACT(Pressed)
-	override
+void DigitalButton::tapPressReleased(const Released &e)
+{
+	baseReleased(e);
+	if (_impl->GetPressDurationMS(e.time_now) > MAGIC_INSTANT_DURATION)
 	{
-		DigitalButtonState::react(e);
-		if (pimpl()->_masterPress->getState() != BtnState::SimPressMaster)
-		{
-			// The master button has released! change state now!
-			changeState<SimRelease>();
-			pimpl()->_masterPress = nullptr;
-		}
-		// else do nothing
+		_impl->ReleaseInstant(BtnEvent::OnRelease);
+		_impl->ReleaseInstant(BtnEvent::OnTap);
 	}
-
-	REACT(Released)
-	override
+	if (!_impl->_keyToRelease || _impl->GetPressDurationMS(e.time_now) > _impl->_keyToRelease->getTapDuration())
 	{
-		DigitalButtonState::react(e);
-		if (pimpl()->_masterPress->getState() != BtnState::SimPressMaster)
-		{
-			// The master button has released! change state now!
-			changeState<SimRelease>();
-			pimpl()->_masterPress = nullptr;
-		}
-		else
-		{
-			// Process at the master's end
-			Sync sync;
-			sync.pressTime = e.time_now;
-			sync.holdTime = e.holdTime;
-			sync.turboTime = e.turboTime;
-			sync.dblPressWindow = e.dblPressWindow;
-			_nextState = pimpl()->_masterPress->sendEvent(sync).nextState;
-		}
+		changeState(BtnState::NoPress);
 	}
-};
+}
 
-class WaitSim : public DigitalButtonState
+void DigitalButton::waitSimPressed(const Pressed &e)
 {
-	DB_CONCRETE_STATE(WaitSim)
-
-	REACT(Pressed)
-	override
+	basePressed(e);
+	// Is there a sim mapping on this button where the other button is in WaitSim state too?
+	ComboPartner partner;
+	auto simBtn = _impl->_context->_getMatchingSimBtn(_id, partner);
+	if (simBtn)
 	{
-		DigitalButtonState::react(e);
-		// Is there a sim mapping on this button where the other button is in WaitSim state too?
-		auto simBtn = pimpl()->_context->_getMatchingSimBtn(pimpl()->_id);
-		if (simBtn)
-		{
-			changeState<SimPressSlave>();
-			pimpl()->_press_times = e.time_now;                                          // reset Timer
-			pimpl()->_keyToRelease = pimpl()->_mapping.atSimPress(simBtn->_id)->value(); // Make a copy
-			pimpl()->_nameToRelease = pimpl()->_mapping.getSimPressName(simBtn->_id);
-			pimpl()->_masterPress = simBtn; // Second to press is the slave
-
-			Sync sync;
-			sync.nextState = new SimPressMaster();
-			sync.pressTime = e.time_now;
-			sync.activeMapping = &*pimpl()->_keyToRelease;
-			sync.nameToRelease = pimpl()->_nameToRelease;
-			sync.dblPressWindow = e.dblPressWindow;
-			simBtn->sendEvent(sync);
-		}
-		else if (pimpl()->GetPressDurationMS(e.time_now) > SettingsManager::getV<float>(SettingID::SIM_PRESS_WINDOW)->value())
-		{
-			// Button is still pressed but Sim delay did expire
-			if (pimpl()->_mapping.getDblPressMap())
-			{
-				// Start counting time between two start presses
-				changeState<DblPressStart>();
-			}
-			else if (pimpl()->_mapping.hasDiagMappings())
-			{
-				size_t counter = 0;
-				optional<MapIterator> diag = nullopt;
-				for (auto btn = pimpl()->_context->_getMatchingDiagBtn(pimpl()->_id, diag); btn;
-				     btn = pimpl()->_context->_getMatchingDiagBtn(pimpl()->_id, diag))
-				{
-					// DEBUG_LOG << "Button " << pimpl()->_id << " enables diagonal press with " << btn->_id << " who is in state " << btn->getCurrentStateName() << '\n';
-					pimpl()->_masterPress = btn;
-					pimpl()->_nameToRelease = pimpl()->_mapping.getDiagPressName((*diag)->first);
-					pimpl()->_keyToRelease = (*diag)->second.value();
-					Sync sync;
-					sync.nameToRelease = pimpl()->_nameToRelease;
-					sync.activeMapping = &*pimpl()->_keyToRelease;
-					sync.pressTime = e.time_now;
-					sync.holdTime = e.holdTime;
-					sync.turboTime = e.turboTime;
-					sync.dblPressWindow = e.dblPressWindow;
-					sync.nextState = new DiagPressMaster();
-					pimpl()->_masterPress->sendEvent(sync);
-					++*diag;
-					counter++;
-				}
-
-				if (counter > 0)
-					changeState<DiagPressSlave>();
-				else
-					changeState<BtnPress>();
-			}
-			else // Handle regular press mapping
-			{
-				changeState<BtnPress>();
-				// _press_times = _timeNow;
-			}
-		}
-		// Else let time flow, stay in this state, no output.
+		changeState(BtnState::SimPressSlave);
+		_impl->_press_times = e.time_now;                  // reset Timer
+		_impl->_keyToRelease = partner.mapping->value(); // Make a copy
+		_impl->_nameToRelease = { simBtn->_id, '+', _id };
+		_impl->_masterPress = simBtn; // Second to press is the slave
+
+		Sync sync;
+		sync.nextState = BtnState::SimPressMaster;
+		sync.pressTime = e.time_now;
+		sync.activeMapping = &*_impl->_keyToRelease;
+		sync.nameToRelease = _impl->_nameToRelease;
+		sync.dblPressWindow = e.dblPressWindow;
+		simBtn->sendEvent(sync);
 	}
-
-	REACT(Released)
-	override
+	else if (_impl->GetPressDurationMS(e.time_now) > SettingsManager::getV<float>(SettingID::SIM_PRESS_WINDOW)->value())
 	{
-		DigitalButtonState::react(e);
-		// Button was released before sim delay expired
-		if (pimpl()->_mapping.getDblPressMap())
+		// Button is still pressed but Sim delay did expire
+		if (_impl->_mapping.getDblPressMap())
 		{
 			// Start counting time between two start presses
-			changeState<DblPressStart>();
+			changeState(BtnState::DblPressStart);
 		}
-		else
+		else if (_impl->_mapping.hasDiagMappings())
 		{
-			changeState<BtnPress>();
+			startDiagonalPress(e);
+		}
+		else // Handle regular press mapping
+		{
+			changeState(BtnState::BtnPress);
 		}
 	}
+	// Else let time flow, stay in this state, no output.
+}
 
-	REACT(Sync)
-	override
+void DigitalButton::waitSimReleased(const Released &e)
+{
+	baseReleased(e);
+	// Button was released before sim delay expired
+	if (_impl->_mapping.getDblPressMap())
 	{
-		pimpl()->_masterPress = nullptr;
-		pimpl()->_press_times = e.pressTime;
-		pimpl()->_keyToRelease = *e.activeMapping;
-		pimpl()->_nameToRelease = e.nameToRelease;
-		_nextState = e.nextState; // changeState <typeof(e.nextState)> () 
+		// Start counting time between two start presses
+		changeState(BtnState::DblPressStart);
 	}
-};
+	else
+	{
+		changeState(BtnState::BtnPress);
+	}
+}
 
-class SimRelease : public DigitalButtonState
+void DigitalButton::waitSimSync(Sync &e)
 {
-	DB_CONCRETE_STATE(SimRelease)
+	_impl->_masterPress = nullptr;
+	_impl->_press_times = e.pressTime;
+	_impl->_keyToRelease = *e.activeMapping;
+	_impl->_nameToRelease = e.nameToRelease;
+	changeState(e.nextState);
+}
 
-	REACT(Released)
-	override
+void DigitalButton::simPressSlavePressed(const Pressed &e)
+{
+	basePressed(e);
+	if (_impl->_masterPress->getState() != BtnState::SimPressMaster)
 	{
-		DigitalButtonState::react(e);
-		changeState<NoPress>();
-		pimpl()->ClearKey();
+		// The master button has released! change state now!
+		changeState(BtnState::SimRelease);
+		_impl->_masterPress = nullptr;
 	}
+	// else do nothing
+}
 
-	REACT(Sync)
-	final
+void DigitalButton::simPressSlaveReleased(const Released &e)
+{
+	baseReleased(e);
+	if (_impl->_masterPress->getState() != BtnState::SimPressMaster)
 	{
-		if (e.nextState != nullptr && e.activeMapping != nullptr)
-		{
-			Released rel{ e.pressTime, e.turboTime, e.holdTime };
-			react(rel);
-			// Redirect change of state to the caller of the Sync
-
-			// Activate Diagonal
-			// DEBUG_LOG << "Button " << pimpl()->_id << " enables active diagonal as master\n";
-			pimpl()->_masterPress = nullptr;
-			pimpl()->_keyToRelease = *e.activeMapping;
-			pimpl()->_nameToRelease = e.nameToRelease;
-			pimpl()->_press_times = e.pressTime;
-			delete _nextState;
-			_nextState = e.nextState;
-		}
+		// The master button has released! change state now!
+		changeState(BtnState::SimRelease);
+		_impl->_masterPress = nullptr;
 	}
-};
+	else
+	{
+		// Process at the master's end, who tells us where to go next
+		Sync sync;
+		sync.pressTime = e.time_now;
+		sync.holdTime = e.holdTime;
+		sync.turboTime = e.turboTime;
+		sync.dblPressWindow = e.dblPressWindow;
+		changeState(_impl->_masterPress->sendEvent(sync).nextState);
+	}
+}
+
+void DigitalButton::simReleaseReleased(const Released &e)
+{
+	baseReleased(e);
+	changeState(BtnState::NoPress);
+	_impl->ClearKey();
+}
 
+void DigitalButton::simReleaseSync(Sync &e)
+{
+	if (e.nextState != BtnState::INVALID && e.activeMapping != nullptr)
+	{
+		Released rel{ e.pressTime, e.turboTime, e.holdTime };
+		simReleaseReleased(rel);
+		// Redirect change of state to the caller of the Sync
 
+		// Activate Diagonal
+		// DEBUG_LOG << "Button " << _id << " enables active diagonal as master\n";
+		_impl->_masterPress = nullptr;
+		_impl->_keyToRelease = *e.activeMapping;
+		_impl->_nameToRelease = e.nameToRelease;
+		_impl->_press_times = e.pressTime;
+		changeState(e.nextState);
+	}
+}
 
-class DiagPressSlave : public DigitalButtonState
+void DigitalButton::diagPressSlavePressed(const Pressed &e)
 {
-	DB_CONCRETE_STATE(DiagPressSlave)
+	basePressed(e);
 
-	REACT(Pressed)
-	override
+	if (!_impl->_masterPress || _impl->_masterPress->getState() != BtnState::DiagPressMaster)
 	{
-		DigitalButtonState::react(e);
-
-		if (!pimpl()->_masterPress || pimpl()->_masterPress->getState() != BtnState::DiagPressMaster)
-		{
-			// Master has released me!
-			pimpl()->_masterPress = nullptr;
-			pimpl()->ClearKey();
-			changeState<NoPress>();
-		}
+		// Master has released me!
+		_impl->_masterPress = nullptr;
+		_impl->ClearKey();
+		changeState(BtnState::NoPress);
 	}
+}
 
-	REACT(Released)
-	override
+void DigitalButton::diagPressSlaveReleased(const Released &e)
+{
+	baseReleased(e);
+	if (_impl->_masterPress && _impl->_masterPress->getState() == BtnState::DiagPressMaster)
 	{
-		DigitalButtonState::react(e);
-		if (pimpl()->_masterPress && pimpl()->_masterPress->getState() == BtnState::DiagPressMaster)
+		// Inform Diagonal Master of the release
+		// Here we're swapping the current state of the master and slave buttons. This enables the released button
+		// to process taps and instants whereas the other button can process its own binding activation.
+		size_t next = 0;
+		ComboPartner partner;
+		auto me = _impl->_context->_getMatchingDiagBtn(_impl->_masterPress->_id, next, partner);
+		if (me)
 		{
-			// Inform Diagonal Master of the release
-			// Here we're swapping the current state of the master and slave buttons. This enables the released button
-			// to process taps and instants whereas the other button can process its own binding activation.
-			optional<MapIterator> it;
-			auto me = pimpl()->_context->_getMatchingDiagBtn(pimpl()->_masterPress->_id, it);
-			if (me)
-			{
-				// DEBUG_LOG << pimpl()->_id << " is performing the swap!\n";
-				pimpl()->_masterPress->swapState(*me);
-				//DEBUG_LOG << pimpl()->_id << " is now in state " << getState() << " with mapping " << pimpl()->_nameToRelease << " set to " << pimpl()->_mapping.value() << '\n';
-				//DEBUG_LOG << pimpl()->_masterPress->_id << " is now in state " << pimpl()->_masterPress->getState() << '\n';
-			}
-			else
-			{
-				CERR << "I can't find myself as the other diagonal?!?";
-			}
+			// DEBUG_LOG << _id << " is performing the swap!\n";
+			_impl->_masterPress->swapState(*me, e.time_now);
 		}
-		else 
+		else
 		{
-			pimpl()->_masterPress = nullptr;
-			pimpl()->ClearKey();
-			changeState<NoPress>();
+			CERR << "I can't find myself as the other diagonal?!?";
 		}
 	}
-};
+	else
+	{
+		_impl->_masterPress = nullptr;
+		_impl->ClearKey();
+		changeState(BtnState::NoPress);
+	}
+}
 
-class DblPressStart : public pocket_fsm::NestedStateMachine<ActiveMappingState, DigitalButtonState>
+void DigitalButton::dblPressStartReleased(const Released &e)
 {
-	DB_CONCRETE_STATE(DblPressStart)
-	REACT(OnEntry)
-	override
+	activeReleased(e);
+	// Wait for the second press instead of completing the first one
+	if (_nextState == BtnState::NoPress)
 	{
-		DigitalButtonState::react(e);
-		initialize(new ActiveStartPress(_pimpl));
+		changeState(BtnState::DblPressNoPress);
 	}
-
-	NESTED_REACT(Pressed);
-
-	REACT(Released)
-	override
+	else if (_nextState == BtnState::TapPress)
 	{
-		sendEvent(e);
-		if (_nextState)
-		{
-			if (_nextState->_name == "NoPress")
-			{
-				delete _nextState;
-				_nextState = nullptr;
-				changeState<DblPressNoPress>(_onTransition);
-			}
-			else if (_nextState->_name == "TapPress")
-			{
-				delete _nextState;
-				_nextState = nullptr;
-				changeState<DblPressNoPressTap>(_onTransition);
-			}
-		}
+		changeState(BtnState::DblPressNoPressTap);
 	}
-};
+}
 
-class DblPressNoPress : public DigitalButtonState
+void DigitalButton::dblPressNoPressPressed(const Pressed &e)
 {
-	DB_CONCRETE_STATE(DblPressNoPress)
-
-	REACT(Pressed)
-	override
+	basePressed(e);
+	if (_impl->GetPressDurationMS(e.time_now) > e.dblPressWindow)
 	{
-		DigitalButtonState::react(e);
-		if (pimpl()->GetPressDurationMS(e.time_now) > e.dblPressWindow)
-		{
-			pimpl()->_press_times = e.time_now; // reset Timer to raise a tap
-			changeState<BtnPress>();
-		}
-		else
-		{
-			pimpl()->_press_times = e.time_now;
-			changeState<DblPressPress>();
-		}
+		_impl->_press_times = e.time_now; // reset Timer to raise a tap
+		changeState(BtnState::BtnPress);
 	}
-
-	REACT(Released)
-	override
+	else
 	{
-		DigitalButtonState::react(e);
-		if (pimpl()->GetPressDurationMS(e.time_now) > MAGIC_INSTANT_DURATION)
-		{
-			pimpl()->ReleaseInstant(BtnEvent::OnRelease);
-		}
-
-		if (pimpl()->GetPressDurationMS(e.time_now) > e.dblPressWindow)
-		{
-			changeState<NoPress>();
-		}
+		_impl->_press_times = e.time_now;
+		changeState(BtnState::DblPressPress);
 	}
-};
+}
 
-class DblPressNoPressTap : public DigitalButtonState
+void DigitalButton::dblPressNoPressReleased(const Released &e)
 {
-	DB_CONCRETE_STATE(DblPressNoPressTap)
-	REACT(Pressed)
-	override
+	baseReleased(e);
+	if (_impl->GetPressDurationMS(e.time_now) > MAGIC_INSTANT_DURATION)
 	{
-		if (pimpl()->GetPressDurationMS(e.time_now) > e.dblPressWindow)
-		{
-			pimpl()->_press_times = e.time_now; // reset Timer to raise a tap
-			changeState<TapPress>();
-		}
-		else
-		{
-			pimpl()->_keyToRelease = pimpl()->_mapping.getDblPressMap()->second;
-			pimpl()->_nameToRelease = pimpl()->_mapping.getName(pimpl()->_id);
-			pimpl()->_press_times = e.time_now;
-			changeState<DblPressPress>();
-		}
+		_impl->ReleaseInstant(BtnEvent::OnRelease);
 	}
 
-	REACT(Released)
-	override
+	if (_impl->GetPressDurationMS(e.time_now) > e.dblPressWindow)
 	{
-		if (pimpl()->GetPressDurationMS(e.time_now) > e.dblPressWindow)
-		{
-			pimpl()->_press_times = e.time_now; // reset Timer to raise a tap
-			changeState<TapPress>();
-		}
+		changeState(BtnState::NoPress);
 	}
-};
+}
 
-class DblPressNoPressHold : public DigitalButtonState
+void DigitalButton::dblPressNoPressTapPressed(const Pressed &e)
 {
-	DB_CONCRETE_STATE(DblPressNoPressHold)
-	REACT(Pressed)
+	if (_impl->GetPressDurationMS(e.time_now) > e.dblPressWindow)
 	{
-		DigitalButtonState::react(e);
-		if (pimpl()->GetPressDurationMS(e.time_now) > e.dblPressWindow)
-		{
-			changeState<BtnPress>();
-			// Don't reset timer to preserve hold press behaviour
-			pimpl()->GetPressMapping()->ProcessEvent(BtnEvent::OnPress, *pimpl());
-		}
-		else
-		{
-			changeState<DblPressPress>();
-			pimpl()->_press_times = e.time_now;
-			pimpl()->_keyToRelease = pimpl()->_mapping.getDblPressMap()->second;
-			pimpl()->_nameToRelease = pimpl()->_mapping.getName(pimpl()->_id);
-		}
+		_impl->_press_times = e.time_now; // reset Timer to raise a tap
+		changeState(BtnState::TapPress);
 	}
-
-	REACT(Released)
-	override
+	else
 	{
-		DigitalButtonState::react(e);
-		if (pimpl()->GetPressDurationMS(e.time_now) > e.dblPressWindow)
-		{
-			changeState<BtnPress>();
-			// Don't reset timer to preserve hold press behaviour
-		}
+		_impl->_keyToRelease = _impl->_mapping.getDblPressMap()->second;
+		_impl->_nameToRelease = { _id, ',', _id };
+		_impl->_press_times = e.time_now;
+		changeState(BtnState::DblPressPress);
 	}
-};
+}
 
-class DblPressPress : public pocket_fsm::NestedStateMachine<ActiveMappingState, DigitalButtonState>
+void DigitalButton::dblPressNoPressTapReleased(const Released &e)
 {
-	DB_CONCRETE_STATE(DblPressPress)
-
-	REACT(OnEntry)
-	override
+	if (_impl->GetPressDurationMS(e.time_now) > e.dblPressWindow)
 	{
-		DigitalButtonState::react(e);
-		pimpl()->_keyToRelease = pimpl()->_mapping.getDblPressMap()->second;
-		pimpl()->_nameToRelease = pimpl()->_mapping.getName(pimpl()->_id);
-		initialize(new ActiveStartPress(_pimpl));
+		_impl->_press_times = e.time_now; // reset Timer to raise a tap
+		changeState(BtnState::TapPress);
 	}
+}
 
-	NESTED_REACT(Pressed);
-	NESTED_REACT(Released);
-};
-
-class InstRelease : public DigitalButtonState
+void DigitalButton::dblPressNoPressHoldPressed(const Pressed &e)
 {
-	DB_CONCRETE_STATE(InstRelease)
+	basePressed(e);
+	if (_impl->GetPressDurationMS(e.time_now) > e.dblPressWindow)
+	{
+		changeState(BtnState::BtnPress);
+		// Don't reset timer to preserve hold press behaviour
+		_impl->GetPressMapping()->ProcessEvent(BtnEvent::OnPress, *_impl);
+	}
+	else
+	{
+		changeState(BtnState::DblPressPress);
+		_impl->_press_times = e.time_now;
+		_impl->_keyToRelease = _impl->_mapping.getDblPressMap()->second;
+		_impl->_nameToRelease = { _id, ',', _id };
+	}
+}
 
-	REACT(Pressed)
-	override
+void DigitalButton::dblPressNoPressHoldReleased(const Released &e)
+{
+	baseReleased(e);
+	if (_impl->GetPressDurationMS(e.time_now) > e.dblPressWindow)
 	{
-		DigitalButtonState::react(e);
-		pimpl()->ReleaseInstant(BtnEvent::OnRelease);
-		pimpl()->ClearKey();
-		changeState<NoPress>();
+		changeState(BtnState::BtnPress);
+		// Don't reset timer to preserve hold press behaviour
 	}
+}
+
+void DigitalButton::dblPressPressEntry()
+{
+	_impl->_keyToRelease = _impl->_mapping.getDblPressMap()->second;
+	_impl->_nameToRelease = { _id, ',', _id };
+	activeEntry();
+}
+
+void DigitalButton::instReleasePressed(const Pressed &e)
+{
+	basePressed(e);
+	_impl->ReleaseInstant(BtnEvent::OnRelease);
+	_impl->ClearKey();
+	changeState(BtnState::NoPress);
+}
 
-	REACT(Released)
-	override
+void DigitalButton::instReleaseReleased(const Released &e)
+{
+	baseReleased(e);
+	if (_impl->GetPressDurationMS(e.time_now) > MAGIC_INSTANT_DURATION)
 	{
-		DigitalButtonState::react(e);
-		if (pimpl()->GetPressDurationMS(e.time_now) > MAGIC_INSTANT_DURATION)
-		{
-			pimpl()->ReleaseInstant(BtnEvent::OnRelease);
-			pimpl()->ClearKey();
-			changeState<NoPress>();
-		}
+		_impl->ReleaseInstant(BtnEvent::OnRelease);
+		_impl->ClearKey();
+		changeState(BtnState::NoPress);
 	}
-};
+}
 
 // Top level interface
 
 DigitalButton::DigitalButton(shared_ptr<DigitalButton::Context> _context, JSMButton &mapping)
   : _id(mapping._id)
+  , _impl(new DigitalButtonImpl(mapping, _context))
 {
-	initialize(new NoPress(new DigitalButtonImpl(mapping, _context)));
 }
 
+DigitalButton::DigitalButton(DigitalButton &&other) noexcept = default;
+
+DigitalButton::~DigitalButton() = default;
+
 DigitalButton::Context::Context(Gamepad::Callback virtualControllerCallback, shared_ptr<MotionIf> mainMotion)
   : rightMainMotion(mainMotion)
+  , _deadlineThread(&Context::deadlineLoop, this)
 {
-	chordStack.push_front(ButtonID::NONE); // Always hold mapping none at the end to _handle modeshifts and chords
+	chordStack.push(ButtonID::NONE); // Always hold mapping none at the end to _handle modeshifts and chords
 #ifdef _WIN32
 	auto virtual_controller = SettingsManager::getV<ControllerScheme>(SettingID::VIRTUAL_CONTROLLER);
 	if (virtual_controller->value() != ControllerScheme::NONE)
@@ -1064,3 +1144,60 @@ DigitalButton::Context::Context(Gamepad::Callback virtualControllerCallback, sha
 	}
 #endif
 }
+
+DigitalButton::Context::Context(function<void(ButtonID, string_view, string_view)> trace)
+  : _trace(trace)
+{
+	chordStack.push(ButtonID::NONE); // Always hold mapping none at the end to _handle modeshifts and chords
+}
+
+DigitalButton::Context::~Context()
+{
+	if (_deadlineThread.joinable())
+	{
+		{
+			lock_guard guard(_deadlineLock);
+			_stopDeadlines = true;
+		}
+		_deadlineChanged.notify_one();
+		_deadlineThread.join();
+	}
+}
+
+void DigitalButton::Context::scheduleDeadline(chrono::steady_clock::time_point deadline)
+{
+	lock_guard guard(_deadlineLock);
+	if (deadline < _nextDeadline)
+	{
+		_nextDeadline = deadline;
+		_deadlineChanged.notify_one();
+	}
+}
+
+void DigitalButton::Context::deadlineLoop()
+{
+	Log::setHotThread();
+	unique_lock lock(_deadlineLock);
+	while (!_stopDeadlines)
+	{
+		if (_nextDeadline == chrono::steady_clock::time_point::max())
+		{
+			_deadlineChanged.wait(lock);
+		}
+		else if (_deadlineChanged.wait_until(lock, _nextDeadline) == cv_status::timeout)
+		{
+			// The handlers schedule whatever deadline remains
+			_nextDeadline = chrono::steady_clock::time_point::max();
+			lock.unlock();
+			{
+				lock_guard guard(callback_lock);
+				auto now = chrono::steady_clock::now();
+				for (auto &[handle, fireDeadlines] : deadlineHandlers)
+				{
+					fireDeadlines(now);
+				}
+			}
+			lock.lock();
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#include "FlickOutput.h"
+#include <algorithm>
+
+namespace JSM
+{
+
+FlickOutput::FlickOutput(float rate, bool start)
+  : PollingThread("Flick output thread", std::bind(&FlickOutput::FlickOutputPoll, this, std::placeholders::_1), nullptr, 1, false)
+  , _period(0.f)
+{
+	setRate(rate);
+	if (start)
+		Start();
+}
+
+FlickOutput::~FlickOutput()
+{
+	Join(); // The loop reads the flicks
+}
+
+void FlickOutput::setRate(float rate)
+{
+	_period = rate > 0.f ? 1.f / rate : 0.f;
+}
+
+void FlickOutput::start(const void *owner, chrono::steady_clock::time_point started, float duration, float distance)
+{
+	lock_guard guard(_lock);
+	auto flick = find_if(_flicks.begin(), _flicks.end(), [owner](const Flick &f) { return f.owner == owner; });
+	if (flick == _flicks.end())
+	{
+		_flicks.push_back({ owner, started, duration, distance, 0.f });
+	}
+	else
+	{
+		*flick = { owner, started, duration, distance, 0.f };
+	}
+}
+
+bool FlickOutput::FlickOutputPoll(void *param)
+{
+	Log::setHotThread();
+	auto now = chrono::steady_clock::now();
+	if (chrono::duration<float>(now - _lastOutput).count() < _period)
+		return true;
+	_lastOutput = now;
+
+	float deltaX = 0.f;
+	{
+		lock_guard guard(_lock);
+		for (auto flick = _flicks.begin(); flick != _flicks.end();)
+		{
+			float secondsSinceFlick = chrono::duration<float>(now - flick->started).count();
+			float percent = flick->duration > 0.f ? min(secondsSinceFlick / flick->duration, 1.f) : 1.f;
+			// warping towards 1.0
+			float shapedPercent = 1.f - (1.f - percent) * (1.f - percent);
+			deltaX += (shapedPercent - flick->shapedDone) * flick->distance;
+			flick->shapedDone = shapedPercent;
+			flick = percent >= 1.f ? _flicks.erase(flick) : next(flick);
+		}
+	}
+	if (deltaX != 0.f)
+	{
+		// moveMouse carries the sub pixel remainder over to the next tick
+		moveMouse(deltaX, 0.f);
+	}
+	return true;
+}
+
+} // namespace JSM
@@ -1,5 +1,6 @@
 #include "JoyShock.h"
 #include "InputHelpers.h"
+#include "FlickOutput.h"
 #include <algorithm>
 #define _USE_MATH_DEFINES
 #include <math.h> // M_PI
@@ -9,6 +10,7 @@ extern vector<JSMButton> mappings;
 extern vector<JSMButton> grid_mappings;
 extern float os_mouse_speed;
 extern float last_flick_and_rotation;
+extern unique_ptr<JSM::FlickOutput> flickOutput;
 
 float radial(float vX, float vY, float X, float Y)
 {
@@ -33,11 +35,11 @@ JoyShock::JoyShock(int uniqueHandle, int controllerSplitType, shared_ptr<Digital
   : _handle(uniqueHandle)
   , _splitType(controllerSplitType)
   , _controllerType(jsl->GetControllerType(uniqueHandle))
+  , _deviceId(jsl->GetDeviceIdentifier(uniqueHandle))
   , _triggerState(NUM_ANALOG_TRIGGERS, DstState::NoPress)
-  , _prevTriggerPosition(NUM_ANALOG_TRIGGERS, deque<float>(MAGIC_TRIGGER_SMOOTHING, 0.f))
   , _light_bar(SettingsManager::get<Color>(SettingID::LIGHT_BAR)->value())
   , _context(sharedButtonCommon)
-  , _motion(MotionIf::getNew())
+  , _motion(MotionIf::getNew(SettingsManager::getV<MotionEngine>(SettingID::MOTION_ENGINE)->value()))
   , _leftStick(SettingID::LEFT_STICK_DEADZONE_INNER, SettingID::LEFT_STICK_DEADZONE_OUTER, SettingID::LEFT_RING_MODE,
       SettingID::LEFT_STICK_MODE, ButtonID::LRING, ButtonID::LLEFT, ButtonID::LRIGHT, ButtonID::LUP, ButtonID::LDOWN)
   , _rightStick(SettingID::RIGHT_STICK_DEADZONE_INNER, SettingID::RIGHT_STICK_DEADZONE_OUTER, SettingID::RIGHT_RING_MODE,
@@ -51,8 +53,8 @@ JoyShock::JoyShock(int uniqueHandle, int controllerSplitType, shared_ptr<Digital
 	}
 	_light_bar = getSetting<Color>(SettingID::LIGHT_BAR);
 
-	_context->_getMatchingSimBtn = bind(&JoyShock::getMatchingSimBtn, this, placeholders::_1);
-	_context->_getMatchingDiagBtn = bind(&JoyShock::getMatchingDiagBtn, this, placeholders::_1, placeholders::_2);
+	_context->_getMatchingSimBtn = bind(&JoyShock::getMatchingSimBtn, this, placeholders::_1, placeholders::_2);
+	_context->_getMatchingDiagBtn = bind(&JoyShock::getMatchingDiagBtn, this, placeholders::_1, placeholders::_2, placeholders::_3);
 	_context->_rumble = bind(&JoyShock::sendRumble, this, placeholders::_1, placeholders::_2);
 
 	_buttons.reserve(LAST_ANALOG_TRIGGER); // Don't include touch stick _buttons
@@ -78,10 +80,17 @@ JoyShock::JoyShock(int uniqueHandle, int controllerSplitType, shared_ptr<Digital
 	updateGridSize();
 	_touchpads[0].scroll.init(_touchpads[0].buttons.find(ButtonID::TLEFT)->second, _touchpads[0].buttons.find(ButtonID::TRIGHT)->second);
 	_touchpads[0].verticalScroll.init(_touchpads[0].buttons.find(ButtonID::TUP)->second, _touchpads[0].buttons.find(ButtonID::TDOWN)->second);
+	// Last, so that the deadline thread never sees a partially built device
+	lock_guard guard(_context->callback_lock);
+	_context->deadlineHandlers[_handle] = bind(&JoyShock::fireDeadlines, this, placeholders::_1);
 }
 
 JoyShock ::~JoyShock()
 {
+	{
+		lock_guard guard(_context->callback_lock);
+		_context->deadlineHandlers.erase(_handle);
+	}
 	if (_splitType == JS_SPLIT_TYPE_LEFT)
 	{
 		_context->leftMotion = nullptr;
@@ -259,40 +268,51 @@ AxisSignPair JoyShock::getSetting<AxisSignPair>(SettingID index)
 	throw invalid_argument(ss.str().c_str());
 }
 
-DigitalButton *JoyShock::getMatchingSimBtn(ButtonID index)
+template<>
+GyroSensCurve JoyShock::getSetting<GyroSensCurve>(SettingID index)
 {
-	JSMButton *mapping = int(index) < mappings.size()        ? &mappings[int(index)] :
-	  int(index) - FIRST_TOUCH_BUTTON < grid_mappings.size() ? &grid_mappings[int(index) - FIRST_TOUCH_BUTTON] :
-	                                                           nullptr;
-	DigitalButton *button1 = int(index) < mappings.size()    ? &_buttons[int(index)] :
-	  int(index) - FIRST_TOUCH_BUTTON < grid_mappings.size() ? &_gridButtons[int(index) - FIRST_TOUCH_BUTTON] :
-	                                                           nullptr;
-	if (!mapping)
+	// Look at active chord mappings starting with the latest activates chord
+	for (auto activeChord = _context->chordStack.begin(); activeChord != _context->chordStack.end(); activeChord++)
 	{
-		CERR << "Cannot find the button " << index << '\n';
-	}
-	else if (!button1)
+		optional<GyroSensCurve> opt = getSettingAtChord<GyroSensCurve>(index, *activeChord);
+		if (opt)
+			return *opt;
+	} // Check next Chord
+
+	stringstream ss;
+	ss << "Index " << index << " is not a valid GyroSensCurve setting";
+	throw invalid_argument(ss.str().c_str());
+}
+
+DigitalButton *JoyShock::getButton(ButtonID index)
+{
+	int i = int(index);
+	DigitalButton *button = i >= 0 && i < _buttons.size()    ? &_buttons[i] :
+	  i >= FIRST_TOUCH_BUTTON && i - FIRST_TOUCH_BUTTON < _gridButtons.size() ? &_gridButtons[i - FIRST_TOUCH_BUTTON] :
+	                                                                          nullptr;
+	if (!button)
 	{
-		CERR << "Cannot find the button " << button1 << '\n';
+		CERR << "Cannot find the button " << index << '\n';
 	}
-	else
+	return button;
+}
+
+DigitalButton *JoyShock::getMatchingSimBtn(ButtonID index, ComboPartner &partner)
+{
+	DigitalButton *button1 = getButton(index);
+	if (button1)
 	{
 		// Find the simMapping where the other btn is in the same state as this btn.
 		// POTENTIAL FLAW: The mapping you find may not necessarily be the one that got you in a
 		// Simultaneous state in the first place if there is a second SimPress going on where one
 		// of the _buttons has a third SimMap with this one. I don't know if it's worth solving though...
-		for (auto iter = mapping->getSimMapIter() ; iter ; ++iter)
+		auto simPartners = button1->getMapping().getSimPartners(); // Keep this list alive while scanning it
+		for (auto &simPartner : *simPartners)
 		{
-			DigitalButton *button2 = int(iter->first) < mappings.size()      ? &_buttons[int(iter->first)] :
-			  int(iter->first) - FIRST_TOUCH_BUTTON < grid_mappings.size() ? &_gridButtons[int(iter->first) - FIRST_TOUCH_BUTTON] :
-																				nullptr;
-
-			if (!button2)
-			{
-				CERR << "Cannot find the button " << button2 << '\n';
-			}
-			else if (index != iter->first && button1->getState() == button2->getState())
+			DigitalButton *button2 = getButton(simPartner.id);
+			if (button2 && button1->getState() == button2->getState())
 			{
+				partner = simPartner;
 				return button2;
 			}
 		}
@@ -300,40 +320,19 @@ DigitalButton *JoyShock::getMatchingSimBtn(ButtonID index)
 	return nullptr;
 }
 
-DigitalButton *JoyShock::getMatchingDiagBtn(ButtonID index, optional<MapIterator> &iter)
+DigitalButton *JoyShock::getMatchingDiagBtn(ButtonID index, size_t &next, ComboPartner &partner)
 {
-	JSMButton *mapping = int(index) < mappings.size()        ? &mappings[int(index)] :
-	  int(index) - FIRST_TOUCH_BUTTON < grid_mappings.size() ? &grid_mappings[int(index) - FIRST_TOUCH_BUTTON] :
-	                                                           nullptr;
-	DigitalButton *button1 = int(index) < mappings.size()    ? &_buttons[int(index)] :
-	  int(index) - FIRST_TOUCH_BUTTON < grid_mappings.size() ? &_gridButtons[int(index) - FIRST_TOUCH_BUTTON] :
-	                                                           nullptr;
-	if (!mapping)
+	DigitalButton *button1 = getButton(index);
+	if (button1)
 	{
-		CERR << "Cannot find the button " << index << '\n';
-	}
-	else if (!button1)
-	{
-		CERR << "Cannot find the button " << button1 << '\n';
-	}
-	else
-	{
-		// Find the diagMapping where the other btn is in the same state as this btn.
-		if (!iter)
-			iter = mapping->getDiagMapIter();
-		for (; *iter; ++*iter)
+		// Find the diagMapping where the other btn is pressed, starting from the given position
+		auto diagPartners = button1->getMapping().getDiagPartners(); // Keep this list alive while scanning it
+		for (; next < diagPartners->size(); ++next)
 		{
-			int i = int((*iter)->first);
-			DigitalButton *button2 = i < mappings.size()    ? &_buttons[i] :
-			  i - FIRST_TOUCH_BUTTON < grid_mappings.size() ? &_gridButtons[i - FIRST_TOUCH_BUTTON] :
-			                                                                 nullptr;
-
-			if (!button2)
-			{
-				CERR << "Cannot find the button " << button2 << '\n';
-			}
-			else if (index != (*iter)->first && button2->getState() != BtnState::NoPress)
+			DigitalButton *button2 = getButton((*diagPartners)[next].id);
+			if (button2 && button2->getState() != BtnState::NoPress)
 			{
+				partner = (*diagPartners)[next];
 				return button2;
 			}
 		}
@@ -434,6 +433,50 @@ void JoyShock::getSmoothedGyro(float x, float y, float length, float bottomThres
 	outY = yResult + y * immediateFactor;
 }
 
+void JoyShock::predictGyro(float x, float y, float deltaTime, float horizon, float maxChange, float &outX, float &outY)
+{
+	_frontPredictionSample--;
+	if (_frontPredictionSample < 0)
+		_frontPredictionSample = MAX_PREDICTION_SAMPLES - 1;
+	_predictionSamples[_frontPredictionSample] = { x, y };
+	_predictionDeltas[_frontPredictionSample] = deltaTime;
+	_numPredictionSamples = min(_numPredictionSamples + 1, MAX_PREDICTION_SAMPLES);
+
+	if (horizon <= 0.f)
+		return;
+
+	// Least squares slope over the samples within the window, with the time of each sample relative to the newest
+	float sumT = 0.f, sumX = 0.f, sumY = 0.f, sumTT = 0.f, sumTX = 0.f, sumTY = 0.f;
+	float time = 0.f;
+	int count = 0;
+	for (; count < _numPredictionSamples && time >= -MAGIC_GYRO_PREDICTION_WINDOW / 1000.f; ++count)
+	{
+		int index = (_frontPredictionSample + count) % MAX_PREDICTION_SAMPLES;
+		const FloatXY &sample = _predictionSamples[index];
+		sumT += time;
+		sumX += sample.x();
+		sumY += sample.y();
+		sumTT += time * time;
+		sumTX += time * sample.x();
+		sumTY += time * sample.y();
+		time -= _predictionDeltas[index];
+	}
+	float denom = count * sumTT - sumT * sumT;
+	if (count < 3 || denom <= 0.f)
+		return;
+
+	auto extrapolate = [=](float &value, float slope)
+	{
+		// Sensor noise dominates the trend of a slow rotation: the change can't exceed the speed itself
+		float cap = min(maxChange, fabsf(value));
+		float predicted = value + clamp(slope * horizon, -cap, cap);
+		// Decelerating: stop at zero rather than overshoot backwards
+		value = value * predicted < 0.f ? 0.f : predicted;
+	};
+	extrapolate(outX, (count * sumTX - sumT * sumX) / denom);
+	extrapolate(outY, (count * sumTY - sumT * sumY) / denom);
+}
+
 void JoyShock::handleButtonChange(ButtonID id, bool pressed, int touchpadID)
 {
 	DigitalButton *button = int(id) <= LAST_ANALOG_TRIGGER ? &_buttons[int(id)] :
@@ -446,7 +489,14 @@ void JoyShock::handleButtonChange(ButtonID id, bool pressed, int touchpadID)
 		CERR << "Button " << id << " with tocuchpadId " << touchpadID << " could not be found\n";
 		return;
 	}
-	else if ((!_context->nn && pressed) || (_context->nn > 0 && (id >= ButtonID::UP || id <= ButtonID::DOWN || id == ButtonID::S || id == ButtonID::E) && nnm.find(_context->nn) != nnm.end() && nnm.find(_context->nn)->second == id))
+
+	bool isPressed = (!_context->nn && pressed) || (_context->nn > 0 && (id >= ButtonID::UP || id <= ButtonID::DOWN || id == ButtonID::S || id == ButtonID::E) && nnm.find(_context->nn) != nnm.end() && nnm.find(_context->nn)->second == id);
+	if (!isPressed && button->isIdle())
+	{
+		// Only edges and the states that count time need events, which leaves out most buttons on most polls
+		return;
+	}
+	else if (isPressed)
 	{
 		Pressed evt;
 		evt.time_now = _timeNow;
@@ -466,12 +516,12 @@ void JoyShock::handleButtonChange(ButtonID id, bool pressed, int touchpadID)
 	}
 }
 
-float JoyShock::getTriggerEffectStartPos()
+float JoyShock::getTriggerThreshold()
 {
 	float threshold = getSetting(SettingID::TRIGGER_THRESHOLD);
 	if (_controllerType == JS_TYPE_DS && getSetting<Switch>(SettingID::ADAPTIVE_TRIGGER) != Switch::OFF)
 		threshold = max(0.f, threshold); // hair trigger disabled on dual sense when adaptive triggers are active
-	return clamp(threshold + 0.05f, 0.0f, 1.0f);
+	return threshold;
 }
 
 void JoyShock::handleTriggerChange(ButtonID softIndex, ButtonID fullIndex, TriggerMode mode, float position, AdaptiveTriggerSetting &trigger_rumble)
@@ -485,12 +535,27 @@ void JoyShock::handleTriggerChange(ButtonID softIndex, ButtonID fullIndex, Trigg
 		return;
 	}
 
+	// Reports received since the last poll, for the hair trigger. The last one is the current position.
+	// They are collected whatever the mode, so that none are left over for the next time the hair trigger runs.
+	array<float, MAX_TRIGGER_REPORTS> reports;
+	int numReports = softIndex == ButtonID::ZL || softIndex == ButtonID::ZR ?
+	  jsl->GetTriggerHistory(_handle, softIndex == ButtonID::ZL, reports.data(), int(reports.size())) :
+	  0; // The touchpad dual stage has no reports of its own
+	span<const float> previousReports(reports.data(), max(numReports - 1, 0));
+
 	if (mode != TriggerMode::X_LT && mode != TriggerMode::X_RT && (_controllerType == JS_TYPE_PRO_CONTROLLER || _controllerType == JS_TYPE_JOYCON_LEFT || _controllerType == JS_TYPE_JOYCON_RIGHT))
 	{
 		// Override local variable because the controller has digital triggers. Effectively ignore Full Pull binding.
 		mode = TriggerMode::NO_FULL;
 	}
 
+	if (mode == TriggerMode::X_LT || mode == TriggerMode::X_RT)
+	{
+		// The hair trigger starts over when the mode switches back
+		_triggerHistory[idxState] = {};
+		_pendingSoftRelease[idxState] = false;
+	}
+
 	if (mode == TriggerMode::X_LT)
 	{
 		if (_context->_vigemController)
@@ -526,235 +591,271 @@ void JoyShock::handleTriggerChange(ButtonID softIndex, ButtonID fullIndex, Trigg
 		handleButtonChange(fullIndex, false);
 	}
 
-	switch (_triggerState[idxState])
+	float threshold = getTriggerThreshold();
+	TriggerFrame frame{ softIndex, fullIndex, mode, position, trigger_rumble, offset, range,
+	  clamp(threshold + 0.05f, 0.0f, 1.0f), getSetting(SettingID::TRIGGER_SKIP_DELAY),
+	  isSoftPullPressed(idxState, threshold, position, previousReports), _triggerState[idxState] };
+	(this->*TRIGGER_STATE_HANDLERS[size_t(_triggerState[idxState])])(frame);
+}
+
+const array<JoyShock::TriggerStateHandler, size_t(DstState::INVALID) + 1> JoyShock::TRIGGER_STATE_HANDLERS = []()
+{
+	array<TriggerStateHandler, size_t(DstState::INVALID) + 1> handlers;
+	handlers[size_t(DstState::NoPress)] = &JoyShock::handleTriggerNoPress;
+	handlers[size_t(DstState::PressStart)] = &JoyShock::handleTriggerPressStart;
+	handlers[size_t(DstState::QuickSoftTap)] = &JoyShock::handleTriggerQuickSoftTap;
+	handlers[size_t(DstState::QuickFullPress)] = &JoyShock::handleTriggerQuickFullPress;
+	handlers[size_t(DstState::QuickFullRelease)] = &JoyShock::handleTriggerQuickFullRelease;
+	handlers[size_t(DstState::SoftPress)] = &JoyShock::handleTriggerSoftPress;
+	handlers[size_t(DstState::DelayFullPress)] = &JoyShock::handleTriggerDelayFullPress;
+	handlers[size_t(DstState::PressStartResp)] = &JoyShock::handleTriggerPressStartResp;
+	handlers[size_t(DstState::ExclFullPress)] = &JoyShock::handleTriggerExclFullPress;
+	handlers[size_t(DstState::INVALID)] = &JoyShock::handleTriggerInvalid;
+	return handlers;
+}();
+
+void JoyShock::handleTriggerNoPress(TriggerFrame &frame)
+{
+	// It actually doesn't matter what the last Press is. Theoretically, we could have missed the edge.
+	if (frame.mode == TriggerMode::NO_FULL)
 	{
-	case DstState::NoPress:
-		// It actually doesn't matter what the last Press is. Theoretically, we could have missed the edge.
-		if (mode == TriggerMode::NO_FULL)
-		{
-			trigger_rumble.mode = AdaptiveTriggerMode::RESISTANCE_RAW;
-			trigger_rumble.force = UINT16_MAX;
-			trigger_rumble.start = offset + getTriggerEffectStartPos() * range;
-		}
-		else
-		{
-			trigger_rumble.mode = AdaptiveTriggerMode::SEGMENT;
-			trigger_rumble.force = 0.1 * UINT16_MAX;
-			trigger_rumble.start = offset + getTriggerEffectStartPos() * range;
-			trigger_rumble.end = offset + min(1.f, getTriggerEffectStartPos() + 0.1f) * range;
-		}
-		if (isSoftPullPressed(idxState, position))
-		{
-			if (mode == TriggerMode::MAY_SKIP || mode == TriggerMode::MUST_SKIP)
-			{
-				// Start counting press time to see if soft binding should be skipped
-				_triggerState[idxState] = DstState::PressStart;
-				_buttons[int(softIndex)].sendEvent(_timeNow);
-			}
-			else if (mode == TriggerMode::MAY_SKIP_R || mode == TriggerMode::MUST_SKIP_R)
-			{
-				_triggerState[idxState] = DstState::PressStartResp;
-				_buttons[int(softIndex)].sendEvent(_timeNow);
-				handleButtonChange(softIndex, true);
-			}
-			else // mode == NO_FULL or NO_SKIP, NO_SKIP_EXCLUSIVE
-			{
-				_triggerState[idxState] = DstState::SoftPress;
-				handleButtonChange(softIndex, true);
-			}
-		}
-		else
-		{
-			handleButtonChange(softIndex, false);
-		}
-		break;
-	case DstState::PressStart:
-		// don't change trigger rumble : keep whatever was set at no press
-		if (!isSoftPullPressed(idxState, position))
-		{
-			// Trigger has been quickly tapped on the soft press
-			_triggerState[idxState] = DstState::QuickSoftTap;
-			handleButtonChange(softIndex, true);
-		}
-		else if (position == 1.0)
-		{
-			// Trigger has been full pressed quickly
-			_triggerState[idxState] = DstState::QuickFullPress;
-			handleButtonChange(fullIndex, true);
-		}
-		else
+		frame.effect.mode = AdaptiveTriggerMode::RESISTANCE_RAW;
+		frame.effect.force = UINT16_MAX;
+		frame.effect.start = frame.offset + frame.effectStartPos * frame.range;
+	}
+	else
+	{
+		frame.effect.mode = AdaptiveTriggerMode::SEGMENT;
+		frame.effect.force = 0.1 * UINT16_MAX;
+		frame.effect.start = frame.offset + frame.effectStartPos * frame.range;
+		frame.effect.end = frame.offset + min(1.f, frame.effectStartPos + 0.1f) * frame.range;
+	}
+	if (frame.softPressed)
+	{
+		if (frame.mode == TriggerMode::MAY_SKIP || frame.mode == TriggerMode::MUST_SKIP)
 		{
-			GetDuration dur{ _timeNow };
-			if (_buttons[int(softIndex)].sendEvent(dur).out_duration >= getSetting(SettingID::TRIGGER_SKIP_DELAY))
-			{
-				if (mode == TriggerMode::MUST_SKIP)
-				{
-					trigger_rumble.start = offset + (position + 0.05) * range;
-				}
-				_triggerState[idxState] = DstState::SoftPress;
-				// reset the time for hold soft press purposes.
-				_buttons[int(softIndex)].sendEvent(_timeNow);
-				handleButtonChange(softIndex, true);
-			}
+			// Start counting press time to see if soft binding should be skipped
+			frame.state = DstState::PressStart;
+			_buttons[int(frame.softIndex)].sendEvent(_timeNow);
 		}
-		// Else, time passes as soft press is being held, waiting to see if the soft binding should be skipped
-		break;
-	case DstState::PressStartResp:
-		// don't change trigger rumble : keep whatever was set at no press
-		if (!isSoftPullPressed(idxState, position))
+		else if (frame.mode == TriggerMode::MAY_SKIP_R || frame.mode == TriggerMode::MUST_SKIP_R)
 		{
-			// Soft press is being released
-			_triggerState[idxState] = DstState::NoPress;
-			handleButtonChange(softIndex, false);
+			frame.state = DstState::PressStartResp;
+			_buttons[int(frame.softIndex)].sendEvent(_timeNow);
+			handleButtonChange(frame.softIndex, true);
 		}
-		else if (position == 1.0)
+		else // mode == NO_FULL or NO_SKIP, NO_SKIP_EXCLUSIVE
 		{
-			// Trigger has been full pressed quickly
-			_triggerState[idxState] = DstState::QuickFullPress;
-			handleButtonChange(softIndex, false); // Remove soft press
-			handleButtonChange(fullIndex, true);
+			frame.state = DstState::SoftPress;
+			handleButtonChange(frame.softIndex, true);
 		}
-		else
+	}
+	else
+	{
+		handleButtonChange(frame.softIndex, false);
+	}
+}
+
+void JoyShock::handleTriggerPressStart(TriggerFrame &frame)
+{
+	// don't change trigger rumble : keep whatever was set at no press
+	if (!frame.softPressed)
+	{
+		// Trigger has been quickly tapped on the soft press
+		frame.state = DstState::QuickSoftTap;
+		handleButtonChange(frame.softIndex, true);
+	}
+	else if (frame.position == 1.0)
+	{
+		// Trigger has been full pressed quickly
+		frame.state = DstState::QuickFullPress;
+		handleButtonChange(frame.fullIndex, true);
+	}
+	else
+	{
+		GetDuration dur{ _timeNow };
+		if (_buttons[int(frame.softIndex)].sendEvent(dur).out_duration >= frame.skipDelay)
 		{
-			GetDuration dur{ _timeNow };
-			if (_buttons[int(softIndex)].sendEvent(dur).out_duration >= getSetting(SettingID::TRIGGER_SKIP_DELAY))
+			if (frame.mode == TriggerMode::MUST_SKIP)
 			{
-				if (mode == TriggerMode::MUST_SKIP_R)
-				{
-					trigger_rumble.start = offset + (position + 0.05) * range;
-				}
-				_triggerState[idxState] = DstState::SoftPress;
+				frame.effect.start = frame.offset + (frame.position + 0.05) * frame.range;
 			}
-			handleButtonChange(softIndex, true);
-		}
-		break;
-	case DstState::QuickSoftTap:
-		// Soft trigger is already released. Send release now!
-		// don't change trigger rumble : keep whatever was set at no press
-		_triggerState[idxState] = DstState::NoPress;
-		handleButtonChange(softIndex, false);
-		break;
-	case DstState::QuickFullPress:
-		trigger_rumble.mode = AdaptiveTriggerMode::SEGMENT;
-		trigger_rumble.force = UINT16_MAX;
-		trigger_rumble.start = offset + 0.89 * range;
-		trigger_rumble.end = offset + 0.99 * range;
-		if (position < 1.0f)
-		{
-			// Full press is being release
-			_triggerState[idxState] = DstState::QuickFullRelease;
-			handleButtonChange(fullIndex, false);
-		}
-		else
-		{
-			// Full press is being held
-			handleButtonChange(fullIndex, true);
-		}
-		break;
-	case DstState::QuickFullRelease:
-		trigger_rumble.mode = AdaptiveTriggerMode::SEGMENT;
-		trigger_rumble.force = UINT16_MAX;
-		trigger_rumble.start = offset + 0.89 * range;
-		trigger_rumble.end = offset + 0.99 * range;
-		if (!isSoftPullPressed(idxState, position))
-		{
-			_triggerState[idxState] = DstState::NoPress;
-		}
-		else if (position == 1.0f)
-		{
-			// Trigger is being full pressed again
-			_triggerState[idxState] = DstState::QuickFullPress;
-			handleButtonChange(fullIndex, true);
+			frame.state = DstState::SoftPress;
+			// reset the time for hold soft press purposes.
+			_buttons[int(frame.softIndex)].sendEvent(_timeNow);
+			handleButtonChange(frame.softIndex, true);
 		}
-		// else wait for the the trigger to be fully released
-		break;
-	case DstState::SoftPress:
-		if (!isSoftPullPressed(idxState, position))
-		{
-			// Soft press is being released
-			handleButtonChange(softIndex, false);
-			_triggerState[idxState] = DstState::NoPress;
-		}
-		else // Soft Press is being held
+	}
+	// Else, time passes as soft press is being held, waiting to see if the soft binding should be skipped
+}
+
+void JoyShock::handleTriggerPressStartResp(TriggerFrame &frame)
+{
+	// don't change trigger rumble : keep whatever was set at no press
+	if (!frame.softPressed)
+	{
+		// Soft press is being released
+		frame.state = DstState::NoPress;
+		handleButtonChange(frame.softIndex, false);
+	}
+	else if (frame.position == 1.0)
+	{
+		// Trigger has been full pressed quickly
+		frame.state = DstState::QuickFullPress;
+		handleButtonChange(frame.softIndex, false); // Remove soft press
+		handleButtonChange(frame.fullIndex, true);
+	}
+	else
+	{
+		GetDuration dur{ _timeNow };
+		if (_buttons[int(frame.softIndex)].sendEvent(dur).out_duration >= frame.skipDelay)
 		{
-			float tick_time = SettingsManager::get<float>(SettingID::TICK_TIME)->value();
-			if (mode == TriggerMode::NO_SKIP || mode == TriggerMode::MAY_SKIP || mode == TriggerMode::MAY_SKIP_R)
-			{
-				trigger_rumble.force = min(int(UINT16_MAX), trigger_rumble.force + int(1 / 30.f * tick_time * UINT16_MAX));
-				trigger_rumble.start = min(offset + 0.89 * range, trigger_rumble.start + 1 / 150. * tick_time * range);
-				trigger_rumble.end = trigger_rumble.start + 0.1 * range;
-				handleButtonChange(softIndex, true);
-				if (position == 1.0)
-				{
-					// Full press is allowed in addition to soft press
-					_triggerState[idxState] = DstState::DelayFullPress;
-					handleButtonChange(fullIndex, true);
-				}
-			}
-			else if (mode == TriggerMode::NO_SKIP_EXCLUSIVE)
-			{
-				trigger_rumble.force = min(int(UINT16_MAX), trigger_rumble.force + int(1 / 30.f * tick_time * UINT16_MAX));
-				trigger_rumble.start = min(offset + 0.89 * range, trigger_rumble.start + 1 / 150. * tick_time * range);
-				trigger_rumble.end = trigger_rumble.start + 0.1 * range;
-				handleButtonChange(softIndex, false);
-				if (position == 1.0)
-				{
-					_triggerState[idxState] = DstState::ExclFullPress;
-					handleButtonChange(fullIndex, true);
-				}
-			}
-			else // NO_FULL, MUST_SKIP and MUST_SKIP_R
+			if (frame.mode == TriggerMode::MUST_SKIP_R)
 			{
-				trigger_rumble.mode = AdaptiveTriggerMode::RESISTANCE_RAW;
-				trigger_rumble.force = min(int(UINT16_MAX), trigger_rumble.force + int(1 / 30.f * tick_time * UINT16_MAX));
-				// keep old trigger_rumble.start
-				handleButtonChange(softIndex, true);
+				frame.effect.start = frame.offset + (frame.position + 0.05) * frame.range;
 			}
+			frame.state = DstState::SoftPress;
 		}
-		break;
-	case DstState::DelayFullPress:
-		trigger_rumble.mode = AdaptiveTriggerMode::SEGMENT;
-		trigger_rumble.force = UINT16_MAX;
-		trigger_rumble.start = offset + 0.8 * range;
-		trigger_rumble.end = offset + 0.99 * range;
-		if (position < 1.0)
-		{
-			// Full Press is being released
-			_triggerState[idxState] = DstState::SoftPress;
-			handleButtonChange(fullIndex, false);
-		}
-		else // Full press is being held
-		{
-			handleButtonChange(fullIndex, true);
-		}
-		// Soft press is always held regardless
-		handleButtonChange(softIndex, true);
-		break;
-	case DstState::ExclFullPress:
-		trigger_rumble.mode = AdaptiveTriggerMode::SEGMENT;
-		trigger_rumble.force = UINT16_MAX;
-		trigger_rumble.start = offset + 0.89 * range;
-		trigger_rumble.end = offset + 0.99 * range;
-		if (position < 1.0f)
+		handleButtonChange(frame.softIndex, true);
+	}
+}
+
+void JoyShock::handleTriggerQuickSoftTap(TriggerFrame &frame)
+{
+	// Soft trigger is already released. Send release now!
+	// don't change trigger rumble : keep whatever was set at no press
+	frame.state = DstState::NoPress;
+	handleButtonChange(frame.softIndex, false);
+}
+
+void JoyShock::handleTriggerQuickFullPress(TriggerFrame &frame)
+{
+	frame.effect.mode = AdaptiveTriggerMode::SEGMENT;
+	frame.effect.force = UINT16_MAX;
+	frame.effect.start = frame.offset + 0.89 * frame.range;
+	frame.effect.end = frame.offset + 0.99 * frame.range;
+	if (frame.position < 1.0f)
+	{
+		// Full press is being release
+		frame.state = DstState::QuickFullRelease;
+		handleButtonChange(frame.fullIndex, false);
+	}
+	else
+	{
+		// Full press is being held
+		handleButtonChange(frame.fullIndex, true);
+	}
+}
+
+void JoyShock::handleTriggerQuickFullRelease(TriggerFrame &frame)
+{
+	frame.effect.mode = AdaptiveTriggerMode::SEGMENT;
+	frame.effect.force = UINT16_MAX;
+	frame.effect.start = frame.offset + 0.89 * frame.range;
+	frame.effect.end = frame.offset + 0.99 * frame.range;
+	if (!frame.softPressed)
+	{
+		frame.state = DstState::NoPress;
+	}
+	else if (frame.position == 1.0f)
+	{
+		// Trigger is being full pressed again
+		frame.state = DstState::QuickFullPress;
+		handleButtonChange(frame.fullIndex, true);
+	}
+	// else wait for the the trigger to be fully released
+}
+
+void JoyShock::handleTriggerSoftPress(TriggerFrame &frame)
+{
+	if (!frame.softPressed)
+	{
+		// Soft press is being released
+		handleButtonChange(frame.softIndex, false);
+		frame.state = DstState::NoPress;
+		return;
+	}
+
+	// Soft Press is being held
+	float tick_time = SettingsManager::get<float>(SettingID::TICK_TIME)->value();
+	if (frame.mode == TriggerMode::NO_SKIP || frame.mode == TriggerMode::MAY_SKIP || frame.mode == TriggerMode::MAY_SKIP_R)
+	{
+		frame.effect.force = min(int(UINT16_MAX), frame.effect.force + int(1 / 30.f * tick_time * UINT16_MAX));
+		frame.effect.start = min(frame.offset + 0.89 * frame.range, frame.effect.start + 1 / 150. * tick_time * frame.range);
+		frame.effect.end = frame.effect.start + 0.1 * frame.range;
+		handleButtonChange(frame.softIndex, true);
+		if (frame.position == 1.0)
 		{
-			// Full press is being release
-			_triggerState[idxState] = DstState::SoftPress;
-			handleButtonChange(fullIndex, false);
-			handleButtonChange(softIndex, true);
+			// Full press is allowed in addition to soft press
+			frame.state = DstState::DelayFullPress;
+			handleButtonChange(frame.fullIndex, true);
 		}
-		else
+	}
+	else if (frame.mode == TriggerMode::NO_SKIP_EXCLUSIVE)
+	{
+		frame.effect.force = min(int(UINT16_MAX), frame.effect.force + int(1 / 30.f * tick_time * UINT16_MAX));
+		frame.effect.start = min(frame.offset + 0.89 * frame.range, frame.effect.start + 1 / 150. * tick_time * frame.range);
+		frame.effect.end = frame.effect.start + 0.1 * frame.range;
+		handleButtonChange(frame.softIndex, false);
+		if (frame.position == 1.0)
 		{
-			// Full press is being held
-			handleButtonChange(fullIndex, true);
+			frame.state = DstState::ExclFullPress;
+			handleButtonChange(frame.fullIndex, true);
 		}
-		break;
-	default:
-		CERR << "Trigger " << softIndex << " has invalid state " << _triggerState[idxState] << ". Reset to NoPress.\n";
-		_triggerState[idxState] = DstState::NoPress;
-		break;
 	}
+	else // NO_FULL, MUST_SKIP and MUST_SKIP_R
+	{
+		frame.effect.mode = AdaptiveTriggerMode::RESISTANCE_RAW;
+		frame.effect.force = min(int(UINT16_MAX), frame.effect.force + int(1 / 30.f * tick_time * UINT16_MAX));
+		// keep old trigger_rumble.start
+		handleButtonChange(frame.softIndex, true);
+	}
+}
+
+void JoyShock::handleTriggerDelayFullPress(TriggerFrame &frame)
+{
+	frame.effect.mode = AdaptiveTriggerMode::SEGMENT;
+	frame.effect.force = UINT16_MAX;
+	frame.effect.start = frame.offset + 0.8 * frame.range;
+	frame.effect.end = frame.offset + 0.99 * frame.range;
+	if (frame.position < 1.0)
+	{
+		// Full Press is being released
+		frame.state = DstState::SoftPress;
+		handleButtonChange(frame.fullIndex, false);
+	}
+	else // Full press is being held
+	{
+		handleButtonChange(frame.fullIndex, true);
+	}
+	// Soft press is always held regardless
+	handleButtonChange(frame.softIndex, true);
+}
+
+void JoyShock::handleTriggerExclFullPress(TriggerFrame &frame)
+{
+	frame.effect.mode = AdaptiveTriggerMode::SEGMENT;
+	frame.effect.force = UINT16_MAX;
+	frame.effect.start = frame.offset + 0.89 * frame.range;
+	frame.effect.end = frame.offset + 0.99 * frame.range;
+	if (frame.position < 1.0f)
+	{
+		// Full press is being release
+		frame.state = DstState::SoftPress;
+		handleButtonChange(frame.fullIndex, false);
+		handleButtonChange(frame.softIndex, true);
+	}
+	else
+	{
+		// Full press is being held
+		handleButtonChange(frame.fullIndex, true);
+	}
+}
 
-	return;
+void JoyShock::handleTriggerInvalid(TriggerFrame &frame)
+{
+	CERR << "Trigger " << frame.softIndex << " has invalid state " << frame.state << ". Reset to NoPress.\n";
+	frame.state = DstState::NoPress;
 }
 
 bool JoyShock::isPressed(ButtonID btn)
@@ -762,7 +863,7 @@ bool JoyShock::isPressed(ButtonID btn)
 	// Use chord stack to know if a mapping is pressed, because the state from the callback
 	// only holds half the information when it comes to a joycon pair.
 	// Also, NONE is always part of the stack (for chord handling) but NONE is never pressed.
-	return btn != ButtonID::NONE && find(_context->chordStack.begin(), _context->chordStack.end(), btn) != _context->chordStack.end();
+	return btn != ButtonID::NONE && _context->chordStack.contains(btn);
 }
 
 // return true if it hits the outer deadzone
@@ -804,49 +905,135 @@ void JoyShock::updateGridSize()
 	}
 }
 
-bool JoyShock::isSoftPullPressed(int triggerIndex, float triggerPosition)
+optional<bool> JoyShock::isPhysicallyPressed(ButtonID id, int buttons) const
 {
-	float threshold = getSetting(SettingID::TRIGGER_THRESHOLD);
-	if (_controllerType == JS_TYPE_DS && getSetting<Switch>(SettingID::ADAPTIVE_TRIGGER) != Switch::OFF)
-		threshold = max(0.f, threshold); // hair trigger disabled on dual sense when adaptive triggers are active
-	if (threshold >= 0)
-	{
-		return triggerPosition > threshold;
+	// The buttons read the same way on every controller. Grips and function buttons depend on the controller type.
+	static constexpr array<pair<ButtonID, int>, 15> PLAIN_BUTTONS = { {
+	  { ButtonID::UP, JSOFFSET_UP },
+	  { ButtonID::DOWN, JSOFFSET_DOWN },
+	  { ButtonID::LEFT, JSOFFSET_LEFT },
+	  { ButtonID::RIGHT, JSOFFSET_RIGHT },
+	  { ButtonID::L, JSOFFSET_L },
+	  { ButtonID::MINUS, JSOFFSET_MINUS },
+	  { ButtonID::L3, JSOFFSET_LCLICK },
+	  { ButtonID::E, JSOFFSET_E },
+	  { ButtonID::S, JSOFFSET_S },
+	  { ButtonID::N, JSOFFSET_N },
+	  { ButtonID::W, JSOFFSET_W },
+	  { ButtonID::R, JSOFFSET_R },
+	  { ButtonID::PLUS, JSOFFSET_PLUS },
+	  { ButtonID::HOME, JSOFFSET_HOME },
+	  { ButtonID::R3, JSOFFSET_RCLICK },
+	} };
+	if (_context->nn)
+	{
+		return nullopt; // The face buttons and dpad are remapped
+	}
+	auto found = ranges::find(PLAIN_BUTTONS, id, &pair<ButtonID, int>::first);
+	if (found == PLAIN_BUTTONS.end())
+	{
+		return nullopt;
+	}
+	return (buttons & (1 << found->second)) != 0;
+}
+
+void JoyShock::fireDeadlines(chrono::steady_clock::time_point now)
+{
+	int buttons = jsl->GetButtons(_handle);
+	auto fire = [this, now, buttons](DigitalButton &button)
+	{
+		button.fireDeadline(now, isPhysicallyPressed(button._id, buttons));
+		if (auto deadline = button.getDeadline())
+			_context->scheduleDeadline(*deadline);
+	};
+	for_each(_buttons.begin(), _buttons.end(), fire);
+	for_each(_gridButtons.begin(), _gridButtons.end(), fire);
+	for (auto &touchpad : _touchpads)
+	{
+		for (auto &[id, button] : touchpad.buttons)
+		{
+			fire(button);
+		}
 	}
-	// else HAIR TRIGGER
+}
 
+optional<bool> JoyShock::TriggerHistory::push(float position)
+{
 	// Calculate 3 sample averages with the last MAGIC_TRIGGER_SMOOTHING samples + new sample
-	float sum = 0.f;
-	for_each(_prevTriggerPosition[triggerIndex].begin(), _prevTriggerPosition[triggerIndex].begin() + 3, [&sum](auto data)
-	  { sum += data; });
+	auto at = [this](int i)
+	{
+		return positions[(front + i) % MAGIC_TRIGGER_SMOOTHING];
+	};
+	float sum = at(0) + at(1) + at(2);
 	float avg_tm3 = sum / 3.0f;
-	sum = sum - *(_prevTriggerPosition[triggerIndex].begin()) + *(_prevTriggerPosition[triggerIndex].end() - 2);
+	sum = sum - at(0) + at(3);
 	float avg_tm2 = sum / 3.0f;
-	sum = sum - *(_prevTriggerPosition[triggerIndex].begin() + 1) + *(_prevTriggerPosition[triggerIndex].end() - 1);
+	sum = sum - at(1) + at(4);
 	float avg_tm1 = sum / 3.0f;
-	sum = sum - *(_prevTriggerPosition[triggerIndex].begin() + 2) + triggerPosition;
+	sum = sum - at(2) + position;
 	float avg_t0 = sum / 3.0f;
-	// if (avg_t0 > 0) COUT << "Trigger: " << avg_t0 << '\n';
+	positions[front] = position;
+	front = (front + 1) % MAGIC_TRIGGER_SMOOTHING;
 
 	// Soft press is pressed if we got three averaged samples in a row that are pressed
-	bool isPressed;
 	if (avg_t0 > avg_tm1 && avg_tm1 > avg_tm2 && avg_tm2 > avg_tm3)
 	{
-		// DEBUG_LOG << "Hair Trigger pressed: " << avg_t0 << " > " << avg_tm1 << " > " << avg_tm2 << " > " << avg_tm3 << '\n';
-		isPressed = true;
+		return true;
 	}
 	else if (avg_t0 < avg_tm1 && avg_tm1 < avg_tm2 && avg_tm2 < avg_tm3)
 	{
-		// DEBUG_LOG << "Hair Trigger released: " << avg_t0 << " < " << avg_tm1 << " < " << avg_tm2 << " < " << avg_tm3 << '\n';
-		isPressed = false;
+		return false;
 	}
-	else
+	return nullopt;
+}
+
+bool JoyShock::isSoftPullPressed(int triggerIndex, float threshold, float triggerPosition, span<const float> previousReports)
+{
+	// The history is kept up to date in threshold mode too, so that switching to the hair trigger starts clean
+	optional<bool> trend;
+	bool sawPress = false;
+	for (float report : previousReports)
 	{
-		isPressed = _triggerState[triggerIndex] != DstState::NoPress && _triggerState[triggerIndex] != DstState::QuickSoftTap;
+		if (auto reportTrend = _triggerHistory[triggerIndex].push(report))
+		{
+			trend = reportTrend;
+			sawPress |= *reportTrend;
+		}
 	}
-	_prevTriggerPosition[triggerIndex].pop_front();
-	_prevTriggerPosition[triggerIndex].push_back(triggerPosition);
-	return isPressed;
+	if (auto positionTrend = _triggerHistory[triggerIndex].push(triggerPosition))
+	{
+		trend = positionTrend;
+		sawPress |= *positionTrend;
+	}
+	bool pendingRelease = exchange(_pendingSoftRelease[triggerIndex], false);
+
+	if (threshold >= 0)
+	{
+		return triggerPosition > threshold;
+	}
+	// else HAIR TRIGGER: a pull released within the same poll is pressed now and released on the next poll
+	if (sawPress)
+	{
+		_pendingSoftRelease[triggerIndex] = trend == false;
+		return true;
+	}
+	if (pendingRelease && !trend)
+	{
+		return false;
+	}
+	// Otherwise the latest trend wins, or stay as we are
+	return trend.value_or(_triggerState[triggerIndex] != DstState::NoPress && _triggerState[triggerIndex] != DstState::QuickSoftTap);
+}
+
+float JoyShock::getFlickDuration(float deltaFlick)
+{
+	float flickTime = getSetting(SettingID::FLICK_TIME);
+	// don't divide by zero
+	if (abs(deltaFlick) > 0.0f)
+	{
+		flickTime *= pow(abs(deltaFlick) / M_PI, getSetting(SettingID::FLICK_TIME_EXPONENT));
+	}
+	return flickTime;
 }
 
 float JoyShock::handleFlickStick(float stickX, float stickY, Stick &stick, float stickLength, StickMode mode)
@@ -904,6 +1091,13 @@ float JoyShock::handleFlickStick(float stickX, float stickY, Stick &stick, float
 				stick.flick_percent_done = 0.0f;
 				resetSmoothSample();
 				stick.flick_rotation_counter = stickAngle; // track all rotation for this flick
+				stick.flick_streamed = isMouse && flickOutput && flickOutput->isRunning() &&
+				  getSetting<GyroOutput>(SettingID::GYRO_OUTPUT) == GyroOutput::MOUSE;
+				if (stick.flick_streamed)
+				{
+					flickOutput->start(&stick, stick.started_flick, getFlickDuration(stick.delta_flick),
+					  stick.delta_flick * getSetting(SettingID::REAL_WORLD_CALIBRATION) * -mouseCalibrationFactor / getSetting(SettingID::IN_GAME_SENS));
+				}
 				COUT << "Flick: " << setprecision(3) << stickAngle * (180.0f / (float)M_PI) << " degrees\n";
 			}
 		}
@@ -957,16 +1151,16 @@ float JoyShock::handleFlickStick(float stickX, float stickY, Stick &stick, float
 	if (isMouse)
 	{
 		float secondsSinceFlick = ((float)chrono::duration_cast<chrono::microseconds>(_timeNow - stick.started_flick).count()) / 1000000.0f;
-		float newPercent = secondsSinceFlick / getSetting(SettingID::FLICK_TIME);
-
-		// don't divide by zero
-		if (abs(stick.delta_flick) > 0.0f)
-		{
-			newPercent = newPercent / pow(abs(stick.delta_flick) / M_PI, getSetting(SettingID::FLICK_TIME_EXPONENT));
-		}
+		float newPercent = secondsSinceFlick / getFlickDuration(stick.delta_flick);
 
 		if (newPercent > 1.0f)
 			newPercent = 1.0f;
+		if (stick.flick_streamed)
+		{
+			// The flick output thread moves the mouse, only keep track of the progress
+			stick.flick_percent_done = newPercent;
+			return camSpeedX;
+		}
 		// warping towards 1.0
 		float oldShapedPercent = 1.0f - stick.flick_percent_done;
 		oldShapedPercent *= oldShapedPercent;
@@ -1016,457 +1210,486 @@ float JoyShock::handleFlickStick(float stickX, float stickY, Stick &stick, float
 	}
 }
 
-void JoyShock::processStick(float stickX, float stickY, Stick &stick, float mouseCalibrationFactor, float deltaTime, bool &anyStickInput, bool &lockMouse, float &camSpeedX, float &camSpeedY)
+void JoyShock::StickBatch::add(Stick &stick, float stickX, float stickY, bool &anyInput)
 {
-	float temp;
-	auto controllerOrientation = getSetting<ControllerOrientation>(SettingID::CONTROLLER_ORIENTATION);
-	switch (controllerOrientation)
+	sticks[count] = &stick;
+	anyStickInput[count] = &anyInput;
+	x[count] = stickX;
+	y[count] = stickY;
+	++count;
+}
+
+void JoyShock::processSticks(StickBatch &batch, float mouseCalibrationFactor, float deltaTime, bool &lockMouse, float &camSpeedX, float &camSpeedY)
+{
+	// Lanes [0, count) are the current positions, lanes [count, 2 * count) the last ones
+	static constexpr int MAX_LANES = StickBatch::MAX_STICKS * 2;
+	const int count = batch.count;
+	const int lanes = count * 2;
+	array<float, MAX_LANES> x, y, inner, outer, length, scale;
+	array<float, StickBatch::MAX_STICKS> rawLastX, rawLastY;
+
+	// gather
+	for (int i = 0; i < count; ++i)
+	{
+		x[i] = batch.x[i];
+		y[i] = batch.y[i];
+		x[count + i] = batch.sticks[i]->lastX;
+		y[count + i] = batch.sticks[i]->lastY;
+		inner[i] = inner[count + i] = getSetting(batch.sticks[i]->_innerDeadzone);
+		outer[i] = outer[count + i] = 1.0f - getSetting(batch.sticks[i]->_outerDeadzone);
+	}
+
+	// orientation, as a rotation of the stick plane: x' = xx * x + xy * y, y' = yx * x + yy * y
+	float xx = 1.f;
+	float xy = 0.f;
+	float yx = 0.f;
+	float yy = 1.f;
+	switch (getSetting<ControllerOrientation>(SettingID::CONTROLLER_ORIENTATION))
 	{
 	case ControllerOrientation::LEFT:
-		temp = stickX;
-		stickX = -stickY;
-		stickY = temp;
-		temp = stick.lastX;
-		stick.lastX = -stick.lastY;
-		stick.lastY = temp;
+		xx = 0.f;
+		xy = -1.f;
+		yx = 1.f;
+		yy = 0.f;
 		break;
 	case ControllerOrientation::RIGHT:
-		temp = stickX;
-		stickX = stickY;
-		stickY = -temp;
-		temp = stick.lastX;
-		stick.lastX = stick.lastY;
-		stick.lastY = -temp;
+		xx = 0.f;
+		xy = 1.f;
+		yx = -1.f;
+		yy = 0.f;
 		break;
 	case ControllerOrientation::BACKWARD:
-		stickX = -stickX;
-		stickY = -stickY;
-		stick.lastX = -stick.lastX;
-		stick.lastY = -stick.lastY;
+		xx = -1.f;
+		yy = -1.f;
 		break;
 	}
-	auto outerDeadzone = getSetting(stick._outerDeadzone);
-	auto innerDeadzone = getSetting(stick._innerDeadzone);
-	outerDeadzone = 1.0f - outerDeadzone;
-	float rawX = stickX;
-	float rawY = stickY;
-	float rawLength = sqrtf(rawX * rawX + rawY * rawY);
-	float rawLastX = stick.lastX;
-	float rawLastY = stick.lastY;
-	processDeadZones(stick.lastX, stick.lastY, innerDeadzone, outerDeadzone);
-	bool pegged = processDeadZones(stickX, stickY, innerDeadzone, outerDeadzone);
-	float absX = abs(stickX);
-	float absY = abs(stickY);
-	bool left = stickX < -0.5f * absY;
-	bool right = stickX > 0.5f * absY;
-	bool down = stickY < -0.5f * absX;
-	bool up = stickY > 0.5f * absX;
-	float stickLength = sqrtf(stickX * stickX + stickY * stickY);
-	auto ringMode = getSetting<RingMode>(stick._ringMode);
-	auto stickMode = getSetting<StickMode>(stick._stickMode);
-
-	bool ring = ringMode == RingMode::INNER && stickLength > 0.0f && stickLength < 0.7f ||
-	  ringMode == RingMode::OUTER && stickLength > 0.7f;
-	handleButtonChange(stick._ringId, ring, stick._touchpadIndex);
-
-	if (stick.ignore_stick_mode && stickMode == StickMode::INVALID && stickX == 0 && stickY == 0)
+	for (int i = 0; i < lanes; ++i)
+	{
+		float rotatedX = xx * x[i] + xy * y[i];
+		y[i] = yx * x[i] + yy * y[i];
+		x[i] = rotatedX;
+	}
+	for (int i = 0; i < lanes; ++i)
+	{
+		length[i] = sqrtf(x[i] * x[i] + y[i] * y[i]);
+	}
+	for (int i = 0; i < count; ++i)
+	{
+		rawLastX[i] = x[count + i];
+		rawLastY[i] = y[count + i];
+	}
+
+	// deadzones: same result as processDeadZones
+	for (int i = 0; i < lanes; ++i)
+	{
+		float livezone = length[i] >= outer[i] ? 1.f : (length[i] - inner[i]) / (outer[i] - inner[i]);
+		scale[i] = length[i] > inner[i] ? livezone / length[i] : 0.f;
+	}
+
+	// scatter
+	for (int i = 0; i < count; ++i)
+	{
+		Stick &stick = *batch.sticks[i];
+		stick.lastX = x[count + i] * scale[count + i];
+		stick.lastY = y[count + i] * scale[count + i];
+		float stickX = x[i] * scale[i];
+		float stickY = y[i] * scale[i];
+		float stickLength = sqrtf(stickX * stickX + stickY * stickY);
+		bool pegged = length[i] > inner[i] && length[i] >= outer[i];
+		auto ringMode = getSetting<RingMode>(stick._ringMode);
+		auto stickMode = getSetting<StickMode>(stick._stickMode);
+
+		bool ring = ringMode == RingMode::INNER && stickLength > 0.0f && stickLength < 0.7f ||
+		  ringMode == RingMode::OUTER && stickLength > 0.7f;
+		handleButtonChange(stick._ringId, ring, stick._touchpadIndex);
+
+		StickFrame frame{ stickX, stickY, stickLength, x[i], y[i], length[i], rawLastX[i], rawLastY[i], inner[i], outer[i],
+		  pegged, stickMode, deltaTime, *batch.anyStickInput[i], lockMouse, camSpeedX, camSpeedY };
+		(this->*STICK_MODE_HANDLERS[size_t(stickMode)])(stick, frame);
+
+		stick.lastX = batch.x[i];
+		stick.lastY = batch.y[i];
+	}
+}
+
+const array<JoyShock::StickModeHandler, size_t(StickMode::INVALID) + 1> JoyShock::STICK_MODE_HANDLERS = []()
+{
+	array<StickModeHandler, size_t(StickMode::INVALID) + 1> handlers;
+	handlers.fill(&JoyShock::processStickNone); // Steering is handled with the motion stick in the poll callback
+	handlers[size_t(StickMode::NO_MOUSE)] = &JoyShock::processStickButtons;
+	handlers[size_t(StickMode::AIM)] = &JoyShock::processStickAim;
+	handlers[size_t(StickMode::FLICK)] = &JoyShock::processStickFlick;
+	handlers[size_t(StickMode::FLICK_ONLY)] = &JoyShock::processStickFlick;
+	handlers[size_t(StickMode::ROTATE_ONLY)] = &JoyShock::processStickFlick;
+	handlers[size_t(StickMode::MOUSE_RING)] = &JoyShock::processStickMouseRing;
+	handlers[size_t(StickMode::MOUSE_AREA)] = &JoyShock::processStickMouseArea;
+	handlers[size_t(StickMode::OUTER_RING)] = &JoyShock::processStickButtons;
+	handlers[size_t(StickMode::INNER_RING)] = &JoyShock::processStickButtons;
+	handlers[size_t(StickMode::SCROLL_WHEEL)] = &JoyShock::processStickScrollWheel;
+	handlers[size_t(StickMode::HYBRID_AIM)] = &JoyShock::processStickHybridAim;
+	handlers[size_t(StickMode::LEFT_STICK)] = &JoyShock::processStickVirtual;
+	handlers[size_t(StickMode::RIGHT_STICK)] = &JoyShock::processStickVirtual;
+	handlers[size_t(StickMode::LEFT_ANGLE_TO_X)] = &JoyShock::processStickAngleToAxis;
+	handlers[size_t(StickMode::LEFT_ANGLE_TO_Y)] = &JoyShock::processStickAngleToAxis;
+	handlers[size_t(StickMode::RIGHT_ANGLE_TO_X)] = &JoyShock::processStickAngleToAxis;
+	handlers[size_t(StickMode::RIGHT_ANGLE_TO_Y)] = &JoyShock::processStickAngleToAxis;
+	handlers[size_t(StickMode::LEFT_WIND_X)] = &JoyShock::processStickWind;
+	handlers[size_t(StickMode::RIGHT_WIND_X)] = &JoyShock::processStickWind;
+	handlers[size_t(StickMode::INVALID)] = &JoyShock::processStickIgnored;
+	return handlers;
+}();
+
+void JoyShock::processStickNone(Stick &stick, StickFrame &frame)
+{
+}
+
+void JoyShock::processStickIgnored(Stick &stick, StickFrame &frame)
+{
+	if (stick.ignore_stick_mode && frame.stickX == 0 && frame.stickY == 0)
 	{
 		// clear ignore flag when stick is back at neutral
 		stick.ignore_stick_mode = false;
 	}
-	else if (stickMode == StickMode::FLICK || stickMode == StickMode::FLICK_ONLY || stickMode == StickMode::ROTATE_ONLY)
+}
+
+void JoyShock::processStickFlick(Stick &stick, StickFrame &frame)
+{
+	frame.camSpeedX += handleFlickStick(frame.stickX, frame.stickY, stick, frame.stickLength, frame.stickMode);
+	frame.anyStickInput = frame.pegged;
+}
+
+void JoyShock::processStickAim(Stick &stick, StickFrame &frame)
+{
+	// camera movement
+	if (!frame.pegged)
 	{
-		camSpeedX += handleFlickStick(stickX, stickY, stick, stickLength, stickMode);
-		anyStickInput = pegged;
+		stick.acceleration = 1.0f; // reset
 	}
-	else if (stickMode == StickMode::AIM)
+	if (frame.stickLength != 0.0f)
 	{
-		// camera movement
-		if (!pegged)
+		frame.anyStickInput = true;
+		float warpedStickLengthX = getStickPowerCurve()(frame.stickLength);
+		float warpedStickLengthY = warpedStickLengthX;
+		warpedStickLengthX *= getSetting<FloatXY>(SettingID::STICK_SENS).first * getSetting(SettingID::REAL_WORLD_CALIBRATION) / os_mouse_speed / getSetting(SettingID::IN_GAME_SENS);
+		warpedStickLengthY *= getSetting<FloatXY>(SettingID::STICK_SENS).second * getSetting(SettingID::REAL_WORLD_CALIBRATION) / os_mouse_speed / getSetting(SettingID::IN_GAME_SENS);
+		frame.camSpeedX += frame.stickX / frame.stickLength * warpedStickLengthX * stick.acceleration * frame.deltaTime;
+		frame.camSpeedY += frame.stickY / frame.stickLength * warpedStickLengthY * stick.acceleration * frame.deltaTime;
+		if (frame.pegged)
 		{
-			stick.acceleration = 1.0f; // reset
-		}
-		float stickLength = sqrt(stickX * stickX + stickY * stickY);
-		if (stickLength != 0.0f)
-		{
-			anyStickInput = true;
-			float warpedStickLengthX = pow(stickLength, getSetting(SettingID::STICK_POWER));
-			float warpedStickLengthY = warpedStickLengthX;
-			warpedStickLengthX *= getSetting<FloatXY>(SettingID::STICK_SENS).first * getSetting(SettingID::REAL_WORLD_CALIBRATION) / os_mouse_speed / getSetting(SettingID::IN_GAME_SENS);
-			warpedStickLengthY *= getSetting<FloatXY>(SettingID::STICK_SENS).second * getSetting(SettingID::REAL_WORLD_CALIBRATION) / os_mouse_speed / getSetting(SettingID::IN_GAME_SENS);
-			camSpeedX += stickX / stickLength * warpedStickLengthX * stick.acceleration * deltaTime;
-			camSpeedY += stickY / stickLength * warpedStickLengthY * stick.acceleration * deltaTime;
-			if (pegged)
+			stick.acceleration += getSetting(SettingID::STICK_ACCELERATION_RATE) * frame.deltaTime;
+			auto cap = getSetting(SettingID::STICK_ACCELERATION_CAP);
+			if (stick.acceleration > cap)
 			{
-				stick.acceleration += getSetting(SettingID::STICK_ACCELERATION_RATE) * deltaTime;
-				auto cap = getSetting(SettingID::STICK_ACCELERATION_CAP);
-				if (stick.acceleration > cap)
-				{
-					stick.acceleration = cap;
-				}
+				stick.acceleration = cap;
 			}
 		}
 	}
-	else if (stickMode == StickMode::MOUSE_AREA)
+}
+
+void JoyShock::processStickMouseArea(Stick &stick, StickFrame &frame)
+{
+	auto mouse_ring_radius = getSetting(SettingID::MOUSE_RING_RADIUS);
+
+	float mouseX = (frame.rawX - frame.rawLastX) * mouse_ring_radius;
+	float mouseY = (frame.rawY - frame.rawLastY) * -1 * mouse_ring_radius;
+	// do it!
+	moveMouse(mouseX, mouseY);
+}
+
+void JoyShock::processStickMouseRing(Stick &stick, StickFrame &frame)
+{
+	if (frame.stickX != 0.0f || frame.stickY != 0.0f)
 	{
 		auto mouse_ring_radius = getSetting(SettingID::MOUSE_RING_RADIUS);
-
-		float mouseX = (rawX - rawLastX) * mouse_ring_radius;
-		float mouseY = (rawY - rawLastY) * -1 * mouse_ring_radius;
+		float normX = frame.stickX / frame.stickLength;
+		float normY = frame.stickY / frame.stickLength;
+		// use screen resolution
+		float mouseX = getSetting(SettingID::SCREEN_RESOLUTION_X) * 0.5f + 0.5f + normX * mouse_ring_radius;
+		float mouseY = getSetting(SettingID::SCREEN_RESOLUTION_X) * 0.5f + 0.5f - normY * mouse_ring_radius;
+		// normalize
+		mouseX = mouseX / getSetting(SettingID::SCREEN_RESOLUTION_X);
+		mouseY = mouseY / getSetting(SettingID::SCREEN_RESOLUTION_Y);
 		// do it!
-		moveMouse(mouseX, mouseY);
+		setMouseNorm(mouseX, mouseY);
+		frame.lockMouse = true;
 	}
-	else if (stickMode == StickMode::MOUSE_RING)
+}
+
+void JoyShock::processStickScrollWheel(Stick &stick, StickFrame &frame)
+{
+	if (stick.scroll.isInitialized())
 	{
-		if (stickX != 0.0f || stickY != 0.0f)
+		if (frame.stickX == 0 && frame.stickY == 0)
 		{
-			auto mouse_ring_radius = getSetting(SettingID::MOUSE_RING_RADIUS);
-			float stickLength = sqrt(stickX * stickX + stickY * stickY);
-			float normX = stickX / stickLength;
-			float normY = stickY / stickLength;
-			// use screen resolution
-			float mouseX = getSetting(SettingID::SCREEN_RESOLUTION_X) * 0.5f + 0.5f + normX * mouse_ring_radius;
-			float mouseY = getSetting(SettingID::SCREEN_RESOLUTION_X) * 0.5f + 0.5f - normY * mouse_ring_radius;
-			// normalize
-			mouseX = mouseX / getSetting(SettingID::SCREEN_RESOLUTION_X);
-			mouseY = mouseY / getSetting(SettingID::SCREEN_RESOLUTION_Y);
-			// do it!
-			setMouseNorm(mouseX, mouseY);
-			lockMouse = true;
+			stick.scroll.reset(_timeNow);
 		}
-	}
-	else if (stickMode == StickMode::SCROLL_WHEEL)
-	{
-		if (stick.scroll.isInitialized())
+		else if (stick.lastX != 0 && stick.lastY != 0)
 		{
-			if (stickX == 0 && stickY == 0)
+			float lastAngle = atan2f(stick.lastY, stick.lastX) / M_PI * 180.f;
+			float angle = atan2f(frame.stickY, frame.stickX) / M_PI * 180.f;
+			if (((lastAngle > 0) ^ (angle > 0)) && fabsf(angle - lastAngle) > 270.f) // Handle loop the loop
 			{
-				stick.scroll.reset(_timeNow);
+				lastAngle = lastAngle > 0 ? lastAngle - 360.f : lastAngle + 360.f;
 			}
-			else if (stick.lastX != 0 && stick.lastY != 0)
+			// COUT << "Stick moved from " << lastAngle << " to " << angle; // << '\n';
+			if (getSetting<Switch>(SettingID::HIRES_SCROLL) == Switch::ON)
+			{
+				stick.scroll.processHiResScroll(angle - lastAngle, getSetting<FloatXY>(SettingID::SCROLL_SENS).x(), _timeNow);
+			}
+			else
 			{
-				float lastAngle = atan2f(stick.lastY, stick.lastX) / M_PI * 180.f;
-				float angle = atan2f(stickY, stickX) / M_PI * 180.f;
-				if (((lastAngle > 0) ^ (angle > 0)) && fabsf(angle - lastAngle) > 270.f) // Handle loop the loop
-				{
-					lastAngle = lastAngle > 0 ? lastAngle - 360.f : lastAngle + 360.f;
-				}
-				// COUT << "Stick moved from " << lastAngle << " to " << angle; // << '\n';
 				stick.scroll.processScroll(angle - lastAngle, getSetting<FloatXY>(SettingID::SCROLL_SENS).x(), _timeNow);
 			}
 		}
 	}
-	else if (stickMode == StickMode::NO_MOUSE || stickMode == StickMode::INNER_RING || stickMode == StickMode::OUTER_RING)
-	{ // Do not do if invalid
-		// left!
-		handleButtonChange(stick._leftId, left, stick._touchpadIndex);
-		// right!
-		handleButtonChange(stick._rightId, right, stick._touchpadIndex);
-		// up!
-		handleButtonChange(stick._upId, up, stick._touchpadIndex);
-		// down!
-		handleButtonChange(stick._downId, down, stick._touchpadIndex);
+}
 
-		anyStickInput = left || right || up || down; // ring doesn't count
-	}
-	else if (stickMode == StickMode::LEFT_STICK || stickMode == StickMode::RIGHT_STICK)
+void JoyShock::processStickButtons(Stick &stick, StickFrame &frame)
+{
+	float absX = abs(frame.stickX);
+	float absY = abs(frame.stickY);
+	bool left = frame.stickX < -0.5f * absY;
+	bool right = frame.stickX > 0.5f * absY;
+	bool down = frame.stickY < -0.5f * absX;
+	bool up = frame.stickY > 0.5f * absX;
+
+	// left!
+	handleButtonChange(stick._leftId, left, stick._touchpadIndex);
+	// right!
+	handleButtonChange(stick._rightId, right, stick._touchpadIndex);
+	// up!
+	handleButtonChange(stick._upId, up, stick._touchpadIndex);
+	// down!
+	handleButtonChange(stick._downId, down, stick._touchpadIndex);
+
+	frame.anyStickInput = left || right || up || down; // ring doesn't count
+}
+
+void JoyShock::processStickVirtual(Stick &stick, StickFrame &frame)
+{
+	if (_context->_vigemController)
 	{
-		if (_context->_vigemController)
-		{
-			anyStickInput = processGyroStick(stick.lastX, stick.lastY, stickLength, stickMode, false);
-		}
+		frame.anyStickInput = processGyroStick(stick.lastX, stick.lastY, frame.stickLength, frame.stickMode, false);
 	}
-	else if (stickMode >= StickMode::LEFT_ANGLE_TO_X && stickMode <= StickMode::RIGHT_ANGLE_TO_Y)
+}
+
+void JoyShock::processStickAngleToAxis(Stick &stick, StickFrame &frame)
+{
+	if (_context->_vigemController && frame.rawLength > frame.innerDeadzone)
 	{
-		if (_context->_vigemController && rawLength > innerDeadzone)
-		{
-			bool isX = stickMode == StickMode::LEFT_ANGLE_TO_X || stickMode == StickMode::RIGHT_ANGLE_TO_X;
-			bool isLeft = stickMode == StickMode::LEFT_ANGLE_TO_X || stickMode == StickMode::LEFT_ANGLE_TO_Y;
+		float absX = abs(frame.stickX);
+		float absY = abs(frame.stickY);
+		bool isX = frame.stickMode == StickMode::LEFT_ANGLE_TO_X || frame.stickMode == StickMode::RIGHT_ANGLE_TO_X;
+		bool isLeft = frame.stickMode == StickMode::LEFT_ANGLE_TO_X || frame.stickMode == StickMode::LEFT_ANGLE_TO_Y;
 
-			float stickAngle = isX ? atan2f(stickX, absY) : atan2f(stickY, absX);
-			float absAngle = abs(stickAngle * 180.0f / M_PI);
-			float signAngle = stickAngle < 0.f ? -1.f : 1.f;
-			float angleDeadzoneInner = getSetting(SettingID::ANGLE_TO_AXIS_DEADZONE_INNER);
-			float angleDeadzoneOuter = getSetting(SettingID::ANGLE_TO_AXIS_DEADZONE_OUTER);
-			float absStickValue = clamp((absAngle - angleDeadzoneInner) / (90.f - angleDeadzoneOuter - angleDeadzoneInner), 0.f, 1.f);
+		float stickAngle = isX ? atan2f(frame.stickX, absY) : atan2f(frame.stickY, absX);
+		float absAngle = abs(stickAngle * 180.0f / M_PI);
+		float signAngle = stickAngle < 0.f ? -1.f : 1.f;
+		float angleDeadzoneInner = getSetting(SettingID::ANGLE_TO_AXIS_DEADZONE_INNER);
+		float angleDeadzoneOuter = getSetting(SettingID::ANGLE_TO_AXIS_DEADZONE_OUTER);
+		float absStickValue = clamp((absAngle - angleDeadzoneInner) / (90.f - angleDeadzoneOuter - angleDeadzoneInner), 0.f, 1.f);
 
-			absStickValue *= pow(stickLength, getSetting(SettingID::STICK_POWER));
+		absStickValue *= getStickPowerCurve()(frame.stickLength);
 
-			// now actually convert to output stick value, taking deadzones and power curve into account
-			float undeadzoneInner, undeadzoneOuter, unpower;
-			if (isLeft)
+		// now actually convert to output stick value, taking deadzones and power curve into account
+		const StickResponse &response = getVirtualStickResponse(isLeft);
+		if (response.livezoneSize() > 0.f)
+		{
+			frame.anyStickInput = true;
+
+			float signedStickValue = signAngle * response.remap(absStickValue);
+			if (isX)
 			{
-				undeadzoneInner = getSetting(SettingID::LEFT_STICK_UNDEADZONE_INNER);
-				undeadzoneOuter = getSetting(SettingID::LEFT_STICK_UNDEADZONE_OUTER);
-				unpower = getSetting(SettingID::LEFT_STICK_UNPOWER);
+				_context->_vigemController->setStick(signedStickValue, 0.f, isLeft);
 			}
 			else
 			{
-				undeadzoneInner = getSetting(SettingID::RIGHT_STICK_UNDEADZONE_INNER);
-				undeadzoneOuter = getSetting(SettingID::RIGHT_STICK_UNDEADZONE_OUTER);
-				unpower = getSetting(SettingID::RIGHT_STICK_UNPOWER);
-			}
-
-			float livezoneSize = 1.f - undeadzoneOuter - undeadzoneInner;
-			if (livezoneSize > 0.f)
-			{
-				anyStickInput = true;
-
-				// unpower curve
-				if (unpower != 0.f)
-				{
-					absStickValue = pow(absStickValue, 1.f / unpower);
-				}
-
-				if (absStickValue < 1.f)
-				{
-					absStickValue = undeadzoneInner + absStickValue * livezoneSize;
-				}
-
-				float signedStickValue = signAngle * absStickValue;
-				if (isX)
-				{
-					_context->_vigemController->setStick(signedStickValue, 0.f, isLeft);
-				}
-				else
-				{
-					_context->_vigemController->setStick(0.f, signedStickValue, isLeft);
-				}
+				_context->_vigemController->setStick(0.f, signedStickValue, isLeft);
 			}
 		}
 	}
-	else if (stickMode == StickMode::LEFT_WIND_X || stickMode == StickMode::RIGHT_WIND_X)
-	{
-		if (_context->_vigemController)
-		{
-			bool isLeft = stickMode == StickMode::LEFT_WIND_X;
-
-			float &currentWindingAngle = isLeft ? _windingAngleLeft : _windingAngleRight;
-
-			// currently, just use the same hard-coded thresholds we use for flick stick. These are affected by deadzones
-			if (stickLength > 0.f && stick.lastX != 0.f && stick.lastY != 0.f)
-			{
-				// use difference between last stick angle and current
-				float stickAngle = atan2f(-stickX, stickY);
-				float lastStickAngle = atan2f(-stick.lastX, stick.lastY);
-				float angleChange = fmod((stickAngle - lastStickAngle) + M_PI, 2.0f * M_PI);
-				if (angleChange < 0)
-					angleChange += 2.0f * M_PI;
-				angleChange -= M_PI;
-
-				currentWindingAngle -= angleChange * stickLength * 180.f / M_PI;
+}
 
-				anyStickInput = true;
-			}
+void JoyShock::processStickWind(Stick &stick, StickFrame &frame)
+{
+	if (_context->_vigemController)
+	{
+		bool isLeft = frame.stickMode == StickMode::LEFT_WIND_X;
 
-			if (stickLength < 1.f)
-			{
-				float absWindingAngle = abs(currentWindingAngle);
-				float unwindAmount = getSetting(SettingID::UNWIND_RATE) * (1.f - stickLength) * deltaTime;
-				float windingSign = currentWindingAngle < 0.f ? -1.f : 1.f;
-				if (absWindingAngle <= unwindAmount)
-				{
-					currentWindingAngle = 0.f;
-				}
-				else
-				{
-					currentWindingAngle -= unwindAmount * windingSign;
-				}
-			}
+		float &currentWindingAngle = isLeft ? _windingAngleLeft : _windingAngleRight;
 
-			float newWindingSign = currentWindingAngle < 0.f ? -1.f : 1.f;
-			float newAbsWindingAngle = abs(currentWindingAngle);
+		// currently, just use the same hard-coded thresholds we use for flick stick. These are affected by deadzones
+		if (frame.stickLength > 0.f && stick.lastX != 0.f && stick.lastY != 0.f)
+		{
+			// use difference between last stick angle and current
+			float stickAngle = atan2f(-frame.stickX, frame.stickY);
+			float lastStickAngle = atan2f(-stick.lastX, stick.lastY);
+			float angleChange = fmod((stickAngle - lastStickAngle) + M_PI, 2.0f * M_PI);
+			if (angleChange < 0)
+				angleChange += 2.0f * M_PI;
+			angleChange -= M_PI;
 
-			float windingRange = getSetting(SettingID::WIND_STICK_RANGE);
-			float windingPower = getSetting(SettingID::WIND_STICK_POWER);
-			if (windingPower == 0.f)
-			{
-				windingPower = 1.f;
-			}
+			currentWindingAngle -= angleChange * frame.stickLength * 180.f / M_PI;
 
-			float windingRemapped = min(pow(newAbsWindingAngle / windingRange * 2.f, windingPower), 1.f);
+			frame.anyStickInput = true;
+		}
 
-			// let's account for deadzone!
-			float undeadzoneInner, undeadzoneOuter, unpower;
-			if (isLeft)
+		if (frame.stickLength < 1.f)
+		{
+			float absWindingAngle = abs(currentWindingAngle);
+			float unwindAmount = getSetting(SettingID::UNWIND_RATE) * (1.f - frame.stickLength) * frame.deltaTime;
+			float windingSign = currentWindingAngle < 0.f ? -1.f : 1.f;
+			if (absWindingAngle <= unwindAmount)
 			{
-				undeadzoneInner = getSetting(SettingID::LEFT_STICK_UNDEADZONE_INNER);
-				undeadzoneOuter = getSetting(SettingID::LEFT_STICK_UNDEADZONE_OUTER);
-				unpower = getSetting(SettingID::LEFT_STICK_UNPOWER);
+				currentWindingAngle = 0.f;
 			}
 			else
 			{
-				undeadzoneInner = getSetting(SettingID::RIGHT_STICK_UNDEADZONE_INNER);
-				undeadzoneOuter = getSetting(SettingID::RIGHT_STICK_UNDEADZONE_OUTER);
-				unpower = getSetting(SettingID::RIGHT_STICK_UNPOWER);
+				currentWindingAngle -= unwindAmount * windingSign;
 			}
+		}
 
-			float livezoneSize = 1.f - undeadzoneOuter - undeadzoneInner;
-			if (livezoneSize > 0.f)
-			{
-				anyStickInput = true;
+		float newWindingSign = currentWindingAngle < 0.f ? -1.f : 1.f;
+		float newAbsWindingAngle = abs(currentWindingAngle);
 
-				// unpower curve
-				if (unpower != 0.f)
-				{
-					windingRemapped = pow(windingRemapped, 1.f / unpower);
-				}
+		float windingRange = getSetting(SettingID::WIND_STICK_RANGE);
+		float windingPower = getSetting(SettingID::WIND_STICK_POWER);
+		if (windingPower == 0.f)
+		{
+			windingPower = 1.f;
+		}
+		_windStickPowerCurve.setExponent(windingPower);
 
-				if (windingRemapped < 1.f)
-				{
-					windingRemapped = undeadzoneInner + windingRemapped * livezoneSize;
-				}
+		float windingRemapped = min(_windStickPowerCurve(newAbsWindingAngle / windingRange * 2.f), 1.f);
 
-				float signedStickValue = newWindingSign * windingRemapped;
-				_context->_vigemController->setStick(signedStickValue, 0.f, isLeft);
-			}
+		// let's account for deadzone!
+		const StickResponse &response = getVirtualStickResponse(isLeft);
+		if (response.livezoneSize() > 0.f)
+		{
+			frame.anyStickInput = true;
+
+			float signedStickValue = newWindingSign * response.remap(windingRemapped);
+			_context->_vigemController->setStick(signedStickValue, 0.f, isLeft);
 		}
 	}
-	else if (stickMode == StickMode::HYBRID_AIM)
-	{
-		float velocityX = rawX - rawLastX;
-		float velocityY = -rawY + rawLastY;
-		float velocity = sqrt(velocityX * velocityX + velocityY * velocityY);
-		float velocityRadial = radial(velocityX, velocityY, rawX, -rawY);
-		float deflection = rawLength;
-		float previousDeflection = sqrt(rawLastX * rawLastX + rawLastY * rawLastY);
-		float magnitude = 0;
-		float angle = atan2f(-rawY, rawX);
-		bool inDeadzone = false;
+}
 
-		// check deadzones
-		if (deflection > innerDeadzone)
+void JoyShock::processStickHybridAim(Stick &stick, StickFrame &frame)
+{
+	float velocityX = frame.rawX - frame.rawLastX;
+	float velocityY = -frame.rawY + frame.rawLastY;
+	float velocity = sqrt(velocityX * velocityX + velocityY * velocityY);
+	float velocityRadial = radial(velocityX, velocityY, frame.rawX, -frame.rawY);
+	float deflection = frame.rawLength;
+	float previousDeflection = sqrt(frame.rawLastX * frame.rawLastX + frame.rawLastY * frame.rawLastY);
+	float magnitude = 0;
+	// direction of the stick, same as cos and sin of atan2f(-rawY, rawX)
+	float cosAngle = deflection > 0.f ? frame.rawX / deflection : 1.f;
+	float sinAngle = deflection > 0.f ? -frame.rawY / deflection : 0.f;
+	bool inDeadzone = false;
+
+	// check deadzones
+	if (deflection > frame.innerDeadzone)
+	{
+		inDeadzone = false;
+		magnitude = (deflection - frame.innerDeadzone) / (frame.outerDeadzone - frame.innerDeadzone);
+
+		// check outer_deadzone
+		if (deflection > frame.outerDeadzone)
 		{
-			inDeadzone = false;
-			magnitude = (deflection - innerDeadzone) / (outerDeadzone - innerDeadzone);
+			// clip outward radial velocity
+			if (velocityRadial > 0.0f)
+			{
+				float dotProduct = velocityX * sinAngle + velocityY * -cosAngle;
+				velocityX = dotProduct * sinAngle;
+				velocityY = dotProduct * -cosAngle;
+			}
+			magnitude = 1.0f;
 
-			// check outer_deadzone
-			if (deflection > outerDeadzone)
+			// check entering
+			if (previousDeflection <= frame.outerDeadzone)
 			{
-				// clip outward radial velocity
-				if (velocityRadial > 0.0f)
+				if (getSetting<Switch>(SettingID::EDGE_PUSH_IS_ACTIVE) == Switch::ON)
 				{
-					float dotProduct = velocityX * sin(angle) + velocityY * -cos(angle);
-					velocityX = dotProduct * sin(angle);
-					velocityY = dotProduct * -cos(angle);
-				}
-				magnitude = 1.0f;
-
-				// check entering
-				if (previousDeflection <= outerDeadzone)
-				{
-					float averageVelocityX = 0.0f;
-					float averageVelocityY = 0.0f;
-					int steps = 0;
-					int counter = stick.smoothingCounter;
-					while (steps < stick.SMOOTHING_STEPS) // sqrt(cumulativeVX * cumulativeVX + cumulativeVY * cumulativeVY) < smoothingDistance &&
-					{
-						averageVelocityX += stick.previousVelocitiesX[counter];
-						averageVelocityY += stick.previousVelocitiesY[counter];
-						if (counter == 0)
-							counter = stick.SMOOTHING_STEPS - 1;
-						else
-							counter--;
-						steps++;
-					}
-
-					if (getSetting<Switch>(SettingID::EDGE_PUSH_IS_ACTIVE) == Switch::ON)
-					{
-						stick.edgePushAmount *= stick.smallestMagnitude;
-						stick.edgePushAmount += radial(averageVelocityX, averageVelocityY, rawX, -rawY) / steps;
-						stick.smallestMagnitude = 1.f;
-					}
+					// velocity of the recent frames, before this one
+					auto average = stick.hybridAimFilter.average();
+					stick.edgePushAmount *= stick.smallestMagnitude;
+					stick.edgePushAmount += radial(average.velocityX, average.velocityY, frame.rawX, -frame.rawY);
+					stick.smallestMagnitude = 1.f;
 				}
 			}
 		}
-		else
+	}
+	else
+	{
+		stick.edgePushAmount = 0.0f;
+		inDeadzone = true;
+	}
+
+	if (magnitude < stick.smallestMagnitude)
+		stick.smallestMagnitude = magnitude;
+
+	// compute output
+	FloatXY sticklikeFactor = getSetting<FloatXY>(SettingID::STICK_SENS);
+	FloatXY mouselikeFactor = getSetting<FloatXY>(SettingID::MOUSELIKE_FACTOR);
+	const PowerCurve &stickPower = getStickPowerCurve();
+	float poweredMagnitude = stickPower(magnitude);
+	float poweredSmallestMagnitude = stickPower(stick.smallestMagnitude);
+	float outputX = sticklikeFactor.x() / 2.f * poweredMagnitude * cosAngle * frame.deltaTime;
+	float outputY = sticklikeFactor.y() / 2.f * poweredMagnitude * sinAngle * frame.deltaTime;
+	outputX += mouselikeFactor.x() * poweredSmallestMagnitude * cosAngle * stick.edgePushAmount;
+	outputY += mouselikeFactor.y() * poweredSmallestMagnitude * sinAngle * stick.edgePushAmount;
+	outputX += mouselikeFactor.x() * velocityX;
+	outputY += mouselikeFactor.y() * velocityY;
+
+	// for smoothing edgePush and clipping on returning to center
+	// probably only needed as deltaTime is faster than the controller's polling rate
+	// (was tested with xbox360 controller which has a polling rate of 125Hz)
+	// The window is in time, so it covers the same span of stick movement at any poll rate.
+	stick.hybridAimFilter.push({ velocityX, velocityY, outputX, outputY, radial(outputX, outputY, frame.rawX, -frame.rawY) },
+	  frame.deltaTime, MAGIC_HYBRID_AIM_WINDOW / 1000.f);
+
+	if (getSetting<Switch>(SettingID::RETURN_DEADZONE_IS_ACTIVE) == Switch::ON)
+	{
+		// 0 means deadzone fully active 1 means unaltered output
+		auto average = stick.hybridAimFilter.average();
+		float averageOutputX = average.outputX;
+		float averageOutputY = average.outputY;
+		float averageOutput = sqrt(averageOutputX * averageOutputX + averageOutputY * averageOutputY);
+		float averageOutputRadial = average.outputRadial;
+		float returnDeadzone1 = 1.f;
+		float angleOutputToCenter = 0;
+		const float returningDeadzone = getSetting(SettingID::RETURN_DEADZONE_ANGLE) / 180.f * M_PI;
+		const float returningCutoff = getSetting(SettingID::RETURN_DEADZONE_ANGLE_CUTOFF) / 180.f * M_PI;
+
+		if (averageOutputRadial < 0.f)
 		{
-			stick.edgePushAmount = 0.0f;
-			inDeadzone = true;
+			angleOutputToCenter = abs(M_PI - acosf((averageOutputX * frame.rawLastX + averageOutputY * -frame.rawLastY) / (averageOutput * previousDeflection))); /// STILL WRONG
+			returnDeadzone1 = angleBasedDeadzone(angleOutputToCenter, returningDeadzone, returningCutoff);
 		}
-
-		if (magnitude < stick.smallestMagnitude)
-			stick.smallestMagnitude = magnitude;
-
-		// compute output
-		FloatXY sticklikeFactor = getSetting<FloatXY>(SettingID::STICK_SENS);
-		FloatXY mouselikeFactor = getSetting<FloatXY>(SettingID::MOUSELIKE_FACTOR);
-		float outputX = sticklikeFactor.x() / 2.f * pow(magnitude, getSetting(SettingID::STICK_POWER)) * cos(angle) * deltaTime;
-		float outputY = sticklikeFactor.y() / 2.f * pow(magnitude, getSetting(SettingID::STICK_POWER)) * sin(angle) * deltaTime;
-		outputX += mouselikeFactor.x() * pow(stick.smallestMagnitude, getSetting(SettingID::STICK_POWER)) * cos(angle) * stick.edgePushAmount;
-		outputY += mouselikeFactor.y() * pow(stick.smallestMagnitude, getSetting(SettingID::STICK_POWER)) * sin(angle) * stick.edgePushAmount;
-		outputX += mouselikeFactor.x() * velocityX;
-		outputY += mouselikeFactor.y() * velocityY;
-
-		// for smoothing edgePush and clipping on returning to center
-		// probably only needed as deltaTime is faster than the controller's polling rate
-		// (was tested with xbox360 controller which has a polling rate of 125Hz)
-		if (stick.smoothingCounter < stick.SMOOTHING_STEPS - 1)
-			stick.smoothingCounter++;
-		else
-			stick.smoothingCounter = 0;
-
-		stick.previousVelocitiesX[stick.smoothingCounter] = velocityX;
-		stick.previousVelocitiesY[stick.smoothingCounter] = velocityY;
-		float outputRadial = radial(outputX, outputY, rawX, -rawY);
-		stick.previousOutputRadial[stick.smoothingCounter] = outputRadial;
-		stick.previousOutputX[stick.smoothingCounter] = outputX;
-		stick.previousOutputY[stick.smoothingCounter] = outputY;
-
-		if (getSetting<Switch>(SettingID::RETURN_DEADZONE_IS_ACTIVE) == Switch::ON)
+		float returnDeadzone2 = 1.f;
+		if (inDeadzone)
 		{
-			// 0 means deadzone fully active 1 means unaltered output
-			float averageOutputX = 0.f;
-			float averageOutputY = 0.f;
-			for (int i = 0; i < stick.SMOOTHING_STEPS; i++)
-			{
-				averageOutputX += stick.previousOutputX[i];
-				averageOutputY += stick.previousOutputY[i];
-			}
-			float averageOutput = sqrt(averageOutputX * averageOutputX + averageOutputY * averageOutputY) / stick.SMOOTHING_STEPS;
-			averageOutputX /= stick.SMOOTHING_STEPS;
-			averageOutputY /= stick.SMOOTHING_STEPS;
-
-			float averageOutputRadial = 0;
-			for (int i = 0; i < stick.SMOOTHING_STEPS; i++)
-			{
-				averageOutputRadial += stick.previousOutputRadial[i];
-			}
-			averageOutputRadial /= stick.SMOOTHING_STEPS;
-			float returnDeadzone1 = 1.f;
-			float angleOutputToCenter = 0;
-			const float returningDeadzone = getSetting(SettingID::RETURN_DEADZONE_ANGLE) / 180.f * M_PI;
-			const float returningCutoff = getSetting(SettingID::RETURN_DEADZONE_ANGLE_CUTOFF) / 180.f * M_PI;
-
 			if (averageOutputRadial < 0.f)
 			{
-				angleOutputToCenter = abs(M_PI - acosf((averageOutputX * rawLastX + averageOutputY * -rawLastY) / (averageOutput * previousDeflection))); /// STILL WRONG
-				returnDeadzone1 = angleBasedDeadzone(angleOutputToCenter, returningDeadzone, returningCutoff);
+				// if angle inward output deadzone based on tangent concentric circle
+				float angleEquivalent = abs(frame.rawLastX * averageOutputY + -frame.rawLastY * -averageOutputX) / averageOutput;
+				returnDeadzone2 = angleBasedDeadzone(angleEquivalent, returningDeadzone, returningCutoff);
 			}
-			float returnDeadzone2 = 1.f;
-			if (inDeadzone)
+			else
 			{
-				if (averageOutputRadial < 0.f)
-				{
-					// if angle inward output deadzone based on tangent concentric circle
-					float angleEquivalent = abs(rawLastX * averageOutputY + -rawLastY * -averageOutputX) / averageOutput;
-					returnDeadzone2 = angleBasedDeadzone(angleEquivalent, returningDeadzone, returningCutoff);
-				}
-				else
-				{
-					// output deadzone based on distance to center
-					float angleEquivalent = asinf(previousDeflection / innerDeadzone);
-					returnDeadzone2 = angleBasedDeadzone(angleEquivalent, returningDeadzone, returningCutoff);
-				}
+				// output deadzone based on distance to center
+				float angleEquivalent = asinf(previousDeflection / frame.innerDeadzone);
+				returnDeadzone2 = angleBasedDeadzone(angleEquivalent, returningDeadzone, returningCutoff);
 			}
-			float returnDeadzone = min({ returnDeadzone1, returnDeadzone2 });
-			outputX *= returnDeadzone;
-			outputY *= returnDeadzone;
-			if (returnDeadzone == 0.f)
-				stick.edgePushAmount = 0.f;
 		}
-		moveMouse(outputX, outputY);
+		float returnDeadzone = min({ returnDeadzone1, returnDeadzone2 });
+		outputX *= returnDeadzone;
+		outputY *= returnDeadzone;
+		if (returnDeadzone == 0.f)
+			stick.edgePushAmount = 0.f;
 	}
+	moveMouse(outputX, outputY);
 }
 
 void JoyShock::handleTouchStickChange(TouchStick &ts, bool down, short movX, short movY, float delta_time)
@@ -1487,9 +1710,9 @@ void JoyShock::handleTouchStickChange(TouchStick &ts, bool down, short movX, sho
 
 	stickX *= float(axisSign.first);
 	stickY *= float(axisSign.second);
-	processStick(stickX, stickY, ts, mouseCalibrationFactor, delta_time, anyStickInput, lockMouse, camSpeedX, camSpeedY);
-	ts.lastX = stickX;
-	ts.lastY = stickY;
+	StickBatch batch;
+	batch.add(ts, stickX, stickY, anyStickInput);
+	processSticks(batch, mouseCalibrationFactor, delta_time, lockMouse, camSpeedX, camSpeedY);
 
 	moveMouse(camSpeedX * float(getSetting<AxisSignPair>(SettingID::TOUCH_STICK_AXIS).first), -camSpeedY * float(getSetting<AxisSignPair>(SettingID::TOUCH_STICK_AXIS).second));
 
@@ -1516,34 +1739,20 @@ bool JoyShock::processGyroStick(float stickX, float stickY, float stickLength, S
 	bool isLeft = stickMode == StickMode::LEFT_STICK;
 	bool gyroMatchesStickMode = (gyroOutput == GyroOutput::LEFT_STICK && stickMode == StickMode::LEFT_STICK) || (gyroOutput == GyroOutput::RIGHT_STICK && stickMode == StickMode::RIGHT_STICK) || stickMode == StickMode::INVALID;
 
-	float undeadzoneInner, undeadzoneOuter, unpower, virtualScale;
-	if (isLeft)
-	{
-		undeadzoneInner = getSetting(SettingID::LEFT_STICK_UNDEADZONE_INNER);
-		undeadzoneOuter = getSetting(SettingID::LEFT_STICK_UNDEADZONE_OUTER);
-		unpower = getSetting(SettingID::LEFT_STICK_UNPOWER);
-		virtualScale = getSetting(SettingID::LEFT_STICK_VIRTUAL_SCALE);
-	}
-	else
-	{
-		undeadzoneInner = getSetting(SettingID::RIGHT_STICK_UNDEADZONE_INNER);
-		undeadzoneOuter = getSetting(SettingID::RIGHT_STICK_UNDEADZONE_OUTER);
-		unpower = getSetting(SettingID::RIGHT_STICK_UNPOWER);
-		virtualScale = getSetting(SettingID::RIGHT_STICK_VIRTUAL_SCALE);
-	}
+	const StickResponse &response = getVirtualStickResponse(isLeft);
+	float undeadzoneInner = response.undeadzoneInner();
+	float livezoneSize = response.livezoneSize();
+	float virtualScale = getSetting(isLeft ? SettingID::LEFT_STICK_VIRTUAL_SCALE : SettingID::RIGHT_STICK_VIRTUAL_SCALE);
 
 	// in order to correctly combine gyro and stick, we need to calculate what the stick aiming is supposed to be doing, add gyro result to it, and convert back to stick
 	float maxStickGameSpeed = getSetting(SettingID::VIRTUAL_STICK_CALIBRATION);
-	float livezoneSize = 1.f - undeadzoneOuter - undeadzoneInner;
 	if (livezoneSize <= 0.f || maxStickGameSpeed <= 0.f)
 	{
 		// can't do anything with that
 		processed_gyro_stick |= gyroMatchesStickMode;
 		return false;
 	}
-	if (unpower == 0.f)
-		unpower = 1.f;
-	float stickVelocity = pow(clamp<float>((stickLength - undeadzoneInner) / livezoneSize, 0.f, 1.f), unpower) * maxStickGameSpeed * virtualScale;
+	float stickVelocity = response.power(clamp<float>((stickLength - undeadzoneInner) / livezoneSize, 0.f, 1.f)) * maxStickGameSpeed * virtualScale;
 	float expectedX = 0.f;
 	float expectedY = 0.f;
 	if (stickVelocity > 0.f)
@@ -1562,10 +1771,7 @@ bool JoyShock::processGyroStick(float stickX, float stickY, float stickLength, S
 	// map gyro velocity to achievable range in 0-1
 	float gyroInStickStrength = targetGyroVelocity >= maxStickGameSpeed ? 1.f : targetGyroVelocity / maxStickGameSpeed;
 	// unpower curve
-	if (unpower != 0.f)
-	{
-		gyroInStickStrength = pow(gyroInStickStrength, 1.f / unpower);
-	}
+	gyroInStickStrength = response.unpower(gyroInStickStrength);
 	// remap to between inner and outer deadzones
 	float gyroStickX = 0.f;
 	float gyroStickY = 0.f;
@@ -1598,4 +1804,81 @@ bool JoyShock::processGyroStick(float stickX, float stickY, float stickLength, S
 	processed_gyro_stick |= gyroMatchesStickMode;
 
 	return stickLength > undeadzoneInner;
-}
\ No newline at end of file
+}
+
+const PowerCurve &JoyShock::getStickPowerCurve()
+{
+	_stickPowerCurve.setExponent(getSetting(SettingID::STICK_POWER));
+	return _stickPowerCurve;
+}
+
+const StickResponse &JoyShock::getVirtualStickResponse(bool isLeft)
+{
+	if (isLeft)
+	{
+		_leftStickResponse.update(getSetting(SettingID::LEFT_STICK_UNDEADZONE_INNER),
+		  getSetting(SettingID::LEFT_STICK_UNDEADZONE_OUTER),
+		  getSetting(SettingID::LEFT_STICK_UNPOWER));
+		return _leftStickResponse;
+	}
+	_rightStickResponse.update(getSetting(SettingID::RIGHT_STICK_UNDEADZONE_INNER),
+	  getSetting(SettingID::RIGHT_STICK_UNDEADZONE_OUTER),
+	  getSetting(SettingID::RIGHT_STICK_UNPOWER));
+	return _rightStickResponse;
+}
+
+float JoyShock::getSinLeanThreshold()
+{
+	float leanThreshold = getSetting(SettingID::LEAN_THRESHOLD);
+	if (leanThreshold != _leanThreshold)
+	{
+		_leanThreshold = leanThreshold;
+		_sinLeanThreshold = sin(leanThreshold * M_PI / 180.f);
+	}
+	return _sinLeanThreshold;
+}
+
+bool JoyShock::skipIdlePoll(const IMU_STATE &imu, chrono::steady_clock::time_point timeNow)
+{
+	// A steady pan barely changes from one sample to the next: look at the calibrated rotation speed itself
+	float offsetX, offsetY, offsetZ;
+	_motion->GetCalibrationOffset(offsetX, offsetY, offsetZ);
+	float gyroSpeed = Vec(imu.gyroX - offsetX, imu.gyroY - offsetY, imu.gyroZ - offsetZ).Length();
+	bool still = gyroSpeed < MAGIC_IDLE_GYRO_SPEED &&
+	  fabsf(imu.accelX - _lastImu.accelX) < MAGIC_STILLNESS_ACCEL_DELTA &&
+	  fabsf(imu.accelY - _lastImu.accelY) < MAGIC_STILLNESS_ACCEL_DELTA &&
+	  fabsf(imu.accelZ - _lastImu.accelZ) < MAGIC_STILLNESS_ACCEL_DELTA;
+	_lastImu = imu;
+
+	array<float, 6> analog = { jsl->GetLeftX(_handle), jsl->GetLeftY(_handle), jsl->GetRightX(_handle), jsl->GetRightY(_handle),
+		jsl->GetLeftTrigger(_handle), jsl->GetRightTrigger(_handle) };
+	bool untouched = jsl->GetButtons(_handle) == 0 && ranges::equal(analog, _idleAnalog, [](float a, float b)
+	                                                    { return fabsf(a - b) < MAGIC_IDLE_ANALOG_DELTA; });
+
+	// Nothing may be waiting on time to pass: active chords, flicks in progress or winding sticks
+	bool settled = _context->chordStack.size() == 1 && _leftStick.flick_percent_done >= 1.f &&
+	  _rightStick.flick_percent_done >= 1.f && _motionStick.flick_percent_done >= 1.f &&
+	  _windingAngleLeft == 0.f && _windingAngleRight == 0.f;
+
+	// Calibration needs every sample
+	bool calibrating = _motion->IsCalibrating() || (_context->leftMotion && _context->leftMotion->IsCalibrating()) ||
+	  SettingsManager::getV<Switch>(SettingID::AUTO_CALIBRATE_GYRO)->value() == Switch::ON;
+
+	float idleTickTime = SettingsManager::getV<float>(SettingID::IDLE_TICK_TIME)->value();
+	if (idleTickTime <= 0.f || !still || !untouched || !settled || calibrating)
+	{
+		_idleAnalog = analog;
+		_lastActivity = timeNow;
+		return false;
+	}
+	if (timeNow - _lastActivity < chrono::duration<float, milli>(MAGIC_IDLE_DELAY))
+	{
+		return false;
+	}
+	if (timeNow - _lastIdlePoll >= chrono::duration<float, milli>(idleTickTime))
+	{
+		_lastIdlePoll = timeNow;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,260 @@
+#include "JoyShockMapper.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+struct Log::Slot
+{
+	Buffer buf;
+	ostream str{ &buf };
+};
+
+namespace
+{
+
+// A formatted piece of a message. Messages longer than a record span consecutive records.
+struct Record
+{
+	static constexpr size_t TEXT_SIZE = 240;
+
+	uint64_t sequence;
+	Log::Level level;
+	bool last; // This record ends the message
+	uint16_t length;
+	char text[TEXT_SIZE];
+};
+
+// Single producer, single consumer queue of the messages of one thread
+class RecordRing
+{
+public:
+	static constexpr size_t CAPACITY = 512;
+
+	// Producer side: either the whole message fits or nothing is queued
+	bool push(Log::Level level, uint64_t sequence, string_view text)
+	{
+		size_t count = max<size_t>(1, (text.size() + Record::TEXT_SIZE - 1) / Record::TEXT_SIZE);
+		size_t tail = _tail.load(memory_order_relaxed);
+		if (count > CAPACITY - (tail - _head.load(memory_order_acquire)))
+		{
+			return false;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			Record &record = _records[(tail + i) % CAPACITY];
+			string_view piece = text.substr(i * Record::TEXT_SIZE, Record::TEXT_SIZE);
+			record.sequence = sequence;
+			record.level = level;
+			record.last = i + 1 == count;
+			record.length = uint16_t(piece.size());
+			memcpy(record.text, piece.data(), piece.size());
+		}
+		_tail.store(tail + count, memory_order_release);
+		return true;
+	}
+
+	// Consumer side
+	const Record *front() const
+	{
+		size_t head = _head.load(memory_order_relaxed);
+		return head == _tail.load(memory_order_acquire) ? nullptr : &_records[head % CAPACITY];
+	}
+
+	void pop()
+	{
+		_head.store(_head.load(memory_order_relaxed) + 1, memory_order_release);
+	}
+
+	atomic<size_t> dropped = 0;
+
+private:
+	array<Record, CAPACITY> _records;
+	atomic<size_t> _head = 0;
+	atomic<size_t> _tail = 0;
+};
+
+class Logger;
+Logger &logger();
+
+// Never destroyed, so that threads still running on exit can log safely
+class Logger
+{
+public:
+	Logger()
+	{
+		thread(&Logger::drainLoop, this).detach();
+		atexit([]
+		  {
+			  // Print what is left. Messages sent from here on are printed right away.
+			  stopped = true;
+			  logger().flush();
+		  });
+	}
+
+	// Queue a message of a hot thread, or drop it if the queue is full
+	void push(Log::Level level, string_view text)
+	{
+		thread_local shared_ptr<RecordRing> ring = registerThread();
+		if (!ring->push(level, _sequence.fetch_add(1, memory_order_relaxed), text))
+		{
+			// The logging thread reports the loss
+			ring->dropped.fetch_add(1, memory_order_relaxed);
+		}
+	}
+
+	// Print a message right away, after the ones already queued
+	void print(Log::Level level, string_view text)
+	{
+		lock_guard guard(_printLock);
+		drain();
+		Log::print(level, text);
+	}
+
+	void flush()
+	{
+		lock_guard guard(_printLock);
+		drain();
+	}
+
+	// Set on exit, once the logging thread can't be relied on anymore
+	static atomic<bool> stopped;
+
+private:
+	// The logging thread wakes up on its own: signaling it would cost a system call to every message
+	static constexpr chrono::milliseconds DRAIN_PERIOD{ 10 };
+
+	// Never waits on the console
+	shared_ptr<RecordRing> registerThread()
+	{
+		auto ring = make_shared<RecordRing>();
+		lock_guard guard(_ringsLock);
+		_rings.push_back(ring);
+		return ring;
+	}
+
+	void drainLoop()
+	{
+		for (;;)
+		{
+			this_thread::sleep_for(DRAIN_PERIOD);
+			flush();
+		}
+	}
+
+	// Print all queued messages in the order they were sent. Called with _printLock held, which makes
+	// this the only consumer of the rings.
+	void drain()
+	{
+		{
+			lock_guard guard(_ringsLock);
+			// Forget the rings of the threads that are gone
+			erase_if(_rings, [](auto &ring) { return ring.use_count() == 1 && !ring->front(); });
+			_draining = _rings;
+		}
+		for (;;)
+		{
+			RecordRing *next = nullptr;
+			for (auto &ring : _draining)
+			{
+				if (auto dropped = ring->dropped.exchange(0, memory_order_relaxed))
+				{
+					Log::print(Log::Level::WARN, "Log is too busy: " + to_string(dropped) + " messages were dropped\n");
+				}
+				auto record = ring->front();
+				if (record && (!next || record->sequence < next->front()->sequence))
+				{
+					next = ring.get();
+				}
+			}
+			if (!next)
+			{
+				break;
+			}
+			_text.clear();
+			Log::Level level = next->front()->level;
+			for (bool last = false; !last; next->pop())
+			{
+				auto record = next->front();
+				_text.append(record->text, record->length);
+				last = record->last;
+			}
+			Log::print(level, _text);
+		}
+		_draining.clear();
+	}
+
+	mutex _ringsLock;
+	vector<shared_ptr<RecordRing>> _rings;
+	mutex _printLock;
+	vector<shared_ptr<RecordRing>> _draining; // Copy of _rings taken by drain()
+	atomic<uint64_t> _sequence = 0;
+	string _text;
+};
+
+atomic<bool> Logger::stopped = false;
+
+// Started with the first message
+Logger &logger()
+{
+	static Logger *instance = new Logger();
+	return *instance;
+}
+
+} // namespace
+
+thread_local vector<unique_ptr<Log::Slot>> Log::_slots;
+thread_local size_t Log::_slotsInUse = 0;
+thread_local bool Log::_hotThread = false;
+
+Log::Slot &Log::acquireSlot()
+{
+	if (_slotsInUse == _slots.size())
+	{
+		_slots.push_back(make_unique<Slot>());
+	}
+	return *_slots[_slotsInUse++];
+}
+
+void Log::releaseSlot()
+{
+	--_slotsInUse;
+}
+
+void Log::push(Level level, string_view text)
+{
+	if (Logger::stopped)
+	{
+		// Shutting down: nobody is left to drain the queue
+		print(level, text);
+	}
+	else if (_hotThread)
+	{
+		logger().push(level, text);
+	}
+	else
+	{
+		logger().print(level, text);
+	}
+}
+
+Log::Log(Level level)
+  : _level(level)
+  , _slot(acquireSlot())
+  , _str(_slot.str)
+{
+}
+
+Log::~Log()
+{
+	push(_level, _slot.buf._text);
+	_slot.buf._text.clear();
+	_str.clear();
+	_str.flags(ios_base::dec | ios_base::skipws);
+	_str.precision(6);
+	_str.width(0);
+	_str.fill(' ');
+	releaseSlot();
+}
@@ -8,7 +8,7 @@ function<bool(string_view)> Mapping::_isCommandValid = function<bool(string_view
 
 ostream &operator<<(ostream &out, const Mapping &mapping)
 {
-	return out << (mapping._command.empty() ? mapping._description : mapping._command);
+	return out << (mapping.command().empty() ? mapping.description() : mapping.command());
 }
 
 istream &operator>>(istream &in, Mapping &mapping)
@@ -20,7 +20,7 @@ istream &operator>>(istream &in, Mapping &mapping)
 	smatch results;
 	int count = 0;
 
-	mapping._command = valueName;
+	mapping.edit().command = valueName;
 	static constexpr string_view rgx = R"(\s*([!\^-]?)((\".*?\")|\w*[0-9A-Z]|\W)([\\\/+'_]?)\s*(.*))";
 	while (regex_match(valueName, results, regex(rgx.data())) && !results[0].str().empty())
 	{
@@ -89,6 +89,19 @@ bool operator==(const Mapping &lhs, const Mapping &rhs)
 	return lhs.command() == rhs.command();
 }
 
+const shared_ptr<const Mapping::Binding> &Mapping::emptyBinding()
+{
+	static const shared_ptr<const Binding> empty = make_shared<Binding>();
+	return empty;
+}
+
+Mapping::Binding &Mapping::edit()
+{
+	auto binding = make_shared<Binding>(*_binding);
+	_binding = binding;
+	return *binding;
+}
+
 Mapping::Mapping(string_view mapping)
 {
 	stringstream ss(mapping.data());
@@ -99,11 +112,78 @@ Mapping::Mapping(string_view mapping)
 	}
 }
 
+void BoundAction::operator()(EventActionIf *btn) const
+{
+	ActionProgram::run(_program, _op, *_action, btn);
+}
+
+size_t ActionProgram::eventCount() const
+{
+	size_t count = 0;
+	for (size_t evt = 0; evt < size_t(BtnEvent::INVALID); ++evt)
+	{
+		count += hasEvent(BtnEvent(evt)) ? 1 : 0;
+	}
+	return count;
+}
+
+void ActionProgram::insert(BtnEvent evt, const Action &action)
+{
+	// Chain with the already existing actions of the event, if any
+	actions.insert(actions.begin() + eventStart[size_t(evt) + 1], action);
+	for (size_t i = size_t(evt) + 1; i < eventStart.size(); ++i)
+	{
+		eventStart[i]++;
+	}
+}
+
+void ActionProgram::run(const shared_ptr<const ActionProgram> &program, Action::Op op, const Action &action, EventActionIf *btn)
+{
+	switch (op)
+	{
+	case Action::Op::Press:
+		btn->ApplyBtnPress(program->keys[action.key]);
+		break;
+	case Action::Op::Release:
+		btn->ApplyBtnRelease(program->keys[action.key]);
+		break;
+	case Action::Op::GyroAction:
+		btn->ApplyGyroAction(program->keys[action.key]);
+		break;
+	case Action::Op::RemoveGyroAction:
+		btn->RemoveGyroAction();
+		break;
+	case Action::Op::Rumble:
+		btn->SetRumble(action.smallRumble, action.bigRumble);
+		break;
+	case Action::Op::StopRumble:
+		btn->SetRumble(0, 0);
+		break;
+	case Action::Op::StartCalibration:
+		btn->StartCalibration();
+		break;
+	case Action::Op::FinishCalibration:
+		btn->FinishCalibration();
+		break;
+	case Action::Op::Command:
+		btn->RunCommand(program->keys[action.key]);
+		break;
+	case Action::Op::Toggle:
+		btn->ApplyButtonToggle(program->keys[action.key], BoundAction(program, action.apply, action), BoundAction(program, action.release, action));
+		break;
+	case Action::Op::Instant:
+		btn->RegisterInstant(action.instantEvent, BoundAction(program, action.release, action));
+		break;
+	case Action::Op::None:
+		break;
+	}
+}
+
 void Mapping::ProcessEvent(BtnEvent evt, EventActionIf &button) const
 {
 	// COUT << button._id << " processes event " << evt << '\n';
-	auto entry = _eventMapping.find(evt);
-	if (entry != _eventMapping.end() && entry->second) // Skip over empty entries
+	auto &program = _binding->program;
+	if (program && program->hasEvent(evt)) // Skip over empty entries
 	{
 		switch (evt)
 		{
@@ -125,53 +205,46 @@ void Mapping::ProcessEvent(BtnEvent evt, EventActionIf &button) const
 			break;
 		}
 
-		if (entry->second)
+		// DEBUG_LOG << button.getDisplayName() << " processes event " << evt << '\n';
+		for (auto i = program->eventStart[size_t(evt)]; i < program->eventStart[size_t(evt) + 1]; ++i)
 		{
-			// DEBUG_LOG << button.getDisplayName() << " processes event " << evt << '\n';
-			entry->second(&button);
+			const Action &action = program->actions[i];
+			ActionProgram::run(program, action.op, action, &button);
 		}
 	}
 }
 
-void Mapping::InsertEventMapping(BtnEvent evt, EventActionIf::Callback action)
-{
-	if (action)
-	{
-		auto existingActions = _eventMapping.find(evt);
-		_eventMapping[evt] = existingActions == _eventMapping.end() ? action :
-		                                                              bind(&RunBothActions, placeholders::_1, existingActions->second, action); // Chain with already existing mapping, if any
-	}
-}
-
 bool Mapping::AddMapping(KeyCode key, EventModifier evtMod, ActionModifier actMod)
 {
-	EventActionIf::Callback apply, apply2, release;
+	Action::Op apply, release;
+	Action action;
 	if (key.code == 0)
 	{
 		return false;
 	}
+	Binding &binding = edit();
 	if (key.code == CALIBRATE)
 	{
-		apply = bind(&EventActionIf::StartCalibration, placeholders::_1);
-		release = bind(&EventActionIf::FinishCalibration, placeholders::_1);
-		_tapDurationMs = MAGIC_EXTENDED_TAP_DURATION; // Unused in regular press
+		apply = Action::Op::StartCalibration;
+		release = Action::Op::FinishCalibration;
+		binding.tapDurationMs = MAGIC_EXTENDED_TAP_DURATION; // Unused in regular press
 	}
 	else if (key.code >= GYRO_INV_X && key.code <= GYRO_TRACKBALL)
 	{
-		apply = bind(&EventActionIf::ApplyGyroAction, placeholders::_1, key);
-		release = bind(&EventActionIf::RemoveGyroAction, placeholders::_1);
-		_tapDurationMs = MAGIC_EXTENDED_TAP_DURATION; // Unused in regular press
+		apply = Action::Op::GyroAction;
+		release = Action::Op::RemoveGyroAction;
+		binding.tapDurationMs = MAGIC_EXTENDED_TAP_DURATION; // Unused in regular press
 	}
 	else if (key.code == COMMAND_ACTION)
 	{
 		_ASSERT_EXPR(Mapping::_isCommandValid, "You need to assign a function to this field. It should be a function that validates the command line.");
-		if (!Mapping::_isCommandValid(key.name))
+		if (!Mapping::_isCommandValid(key.name()))
 		{
-			COUT << "Error: \"" << key.name << "\" is not a valid command\n";
+			COUT << "Error: \"" << key.name() << "\" is not a valid command\n";
 			return false;
 		}
-		apply = bind(&WriteToConsole, key.name);
-		release = EventActionIf::Callback();
+		apply = Action::Op::Command;
+		release = Action::Op::None;
 	}
 	else if (key.code == RUMBLE)
 	{
@@ -180,16 +253,18 @@ bool Mapping::AddMapping(KeyCode key, EventModifier evtMod, ActionModifier actMo
 			int raw;
 			array<uint8_t, 2> bytes;
 		} rumble;
-		rumble.raw = stoi(key.name.substr(1, 4), nullptr, 16);
-		apply = bind(&EventActionIf::SetRumble, placeholders::_1, rumble.bytes[0] << 8, rumble.bytes[1] << 8);
-		release = bind(&EventActionIf::SetRumble, placeholders::_1, 0, 0);
-		_tapDurationMs = MAGIC_EXTENDED_TAP_DURATION; // Unused in regular press
+		rumble.raw = stoi(string(key.name().substr(1, 4)), nullptr, 16);
+		apply = Action::Op::Rumble;
+		release = Action::Op::StopRumble;
+		action.smallRumble = rumble.bytes[0] << 8;
+		action.bigRumble = rumble.bytes[1] << 8;
+		binding.tapDurationMs = MAGIC_EXTENDED_TAP_DURATION; // Unused in regular press
 	}
 	else //
 	{
-		_hasViGEmBtn |= isControllerKey(key.code); // Set flag if vigem button
-		apply = bind(&EventActionIf::ApplyBtnPress, placeholders::_1, key);
-		release = bind(&EventActionIf::ApplyBtnRelease, placeholders::_1, key);
+		binding.hasViGEmBtn |= isControllerKey(key.code); // Set flag if vigem button
+		apply = Action::Op::Press;
+		release = Action::Op::Release;
 	}
 
 	BtnEvent applyEvt, releaseEvt;
@@ -220,46 +295,62 @@ bool Mapping::AddMapping(KeyCode key, EventModifier evtMod, ActionModifier actMo
 		return false;
 	}
 
+	// The program may be shared with copies of this mapping: build a new one
+	auto program = binding.program ? make_shared<ActionProgram>(*binding.program) : make_shared<ActionProgram>();
+	action.key = uint16_t(program->keys.size());
+	program->keys.push_back(key);
+
+	// Each action is a copy of the one holding the key and rumble values, with its own ops
+	auto insert = [&program, &action](BtnEvent evt, Action::Op op, Action::Op apply = Action::Op::None, Action::Op release = Action::Op::None, BtnEvent instantEvent = BtnEvent::INVALID)
+	{
+		if (op != Action::Op::None)
+		{
+			Action step = action;
+			step.op = op;
+			step.apply = apply;
+			step.release = release;
+			step.instantEvent = instantEvent;
+			program->insert(evt, step);
+		}
+	};
+
 	switch (actMod)
 	{
 	case ActionModifier::Toggle:
-		apply = bind(&EventActionIf::ApplyButtonToggle, placeholders::_1, key, apply, release);
-		release = nullptr;
+		insert(applyEvt, Action::Op::Toggle, apply, release);
 		break;
 	case ActionModifier::Instant:
-		apply2 = bind(&EventActionIf::RegisterInstant, placeholders::_1, applyEvt, release);
-		apply = bind(&Mapping::RunBothActions, placeholders::_1, apply, apply2);
-		release = nullptr;
+		insert(applyEvt, apply);
+		insert(applyEvt, Action::Op::Instant, Action::Op::None, release, applyEvt);
 		break;
 	case ActionModifier::Release:
-		apply = release;
-		release = nullptr;
+		insert(applyEvt, release);
 		break;
-	case ActionModifier::INVALID:
-		return false;
-		// None applies no modification... Hey!
-	}
-
-	// Extra turbo handling
-	if (evtMod == EventModifier::TurboPress)
-	{
-		if (actMod == ActionModifier::None) // Regular turbo holds key down and pulses up during the instant window
+	case ActionModifier::None:
+		if (evtMod == EventModifier::TurboPress)
+		{
+			// Regular turbo holds key down and pulses up during the instant window:
+			// send key up and register key down on instant
+			insert(applyEvt, release);
+			insert(applyEvt, Action::Op::Instant, Action::Op::None, apply, applyEvt);
+		}
+		else
 		{
-			apply2 = bind(&EventActionIf::RegisterInstant, placeholders::_1, applyEvt, apply);// send key down on instant
-			apply = bind(&Mapping::RunBothActions, placeholders::_1, release, apply2); // send key up and register key down
+			insert(applyEvt, apply);
 		}
-		// else handled already in instant case above
+		insert(releaseEvt, release);
+		break;
+	default: // ActionModifier::INVALID
+		return false;
 	}
-
-	InsertEventMapping(applyEvt, apply);
-	InsertEventMapping(releaseEvt, release);
+	binding.program = program;
 
 	stringstream ss;
 	// Update Description
-	if (_description.compare("no input") != 0)
+	if (binding.description.compare("no input") != 0)
 	{
-		ss << _description;
-		if (_eventMapping.size() > 2 && _eventMapping.find(BtnEvent::OnPress) != _eventMapping.end())
+		ss << binding.description;
+		if (eventCount() > 2 && binding.program->hasEvent(BtnEvent::OnPress))
 		{
 			ss << " on Start Press";
 		}
@@ -269,33 +360,33 @@ bool Mapping::AddMapping(KeyCode key, EventModifier evtMod, ActionModifier actMo
 	{
 		ss << actMod << " ";
 	}
-	ss << key.name;
-	if (_eventMapping.size() > 3 || evtMod != Mapping::EventModifier::StartPress)
+	ss << key.name();
+	if (eventCount() > 3 || evtMod != Mapping::EventModifier::StartPress)
 	{
 		ss << " on " << evtMod;
 	}
 	// else don't display event modifier when using default binding on single key
-	_description = ss.str();
+	binding.description = ss.str();
 	return true;
 }
 
 bool Mapping::AppendToCommand(KeyCode key, EventModifier evtMod, ActionModifier actMod)
 {
-	if (key.name.empty() || evtMod == EventModifier::INVALID || actMod == ActionModifier::INVALID)
+	if (key.name().empty() || evtMod == EventModifier::INVALID || actMod == ActionModifier::INVALID)
 	{
 		return false;
 	}
 	stringstream ss;
-	if (!_command.empty())
+	if (!command().empty())
 	{
-		ss << _command << " ";
+		ss << command() << " ";
 	}
 
 	if (actMod != ActionModifier::None)
 	{
 		ss << (actMod == ActionModifier::Instant ? '!' : '^');
 	}
-	ss << key.name;
+	ss << key.name();
 
 	if (evtMod != EventModifier::Auto)
 	{
@@ -305,14 +396,6 @@ bool Mapping::AppendToCommand(KeyCode key, EventModifier evtMod, ActionModifier
 		    evtMod == EventModifier::TapPress      ? '\'' :
 		 /* evtMod == EventModifier::HoldPress    */ '_'); 
 	}
-	_command = ss.str();
+	edit().command = ss.str();
 	return true;
 }
-
-void Mapping::RunBothActions(EventActionIf *btn, EventActionIf::Callback action1, EventActionIf::Callback action2)
-{
-	if (action1)
-		action1(btn);
-	if (action2)
-		action2(btn);
-}
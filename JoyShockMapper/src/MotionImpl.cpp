@@ -1,9 +1,13 @@
 #include "MotionIf.h"
 #include "GamepadMotion.hpp"
 
+// Defined in ComplementaryMotion.cpp
+MotionIf *newComplementaryMotion();
+
 class MotionImpl : public MotionIf
 {
 	GamepadMotion gamepadMotion;
+	bool _calibrating = false;
 public:
 	MotionImpl() = default;
 	
@@ -45,11 +49,13 @@ public:
 	virtual void StartContinuousCalibration() override 
 	{
 		gamepadMotion.StartContinuousCalibration();
+		_calibrating = true;
 	}
 
 	virtual void PauseContinuousCalibration() override 
 	{
 		gamepadMotion.PauseContinuousCalibration();
+		_calibrating = false;
 	}
 
 	virtual void ResetContinuousCalibration() override 
@@ -57,6 +63,11 @@ public:
 		gamepadMotion.ResetContinuousCalibration();
 	}
 
+	virtual bool IsCalibrating() override
+	{
+		return _calibrating;
+	}
+
 	virtual void GetCalibrationOffset(float& xOffset, float& yOffset, float& zOffset) override 
 	{
 		gamepadMotion.GetCalibrationOffset(xOffset, yOffset, zOffset);
@@ -87,7 +98,11 @@ public:
 	}
 };
 
-MotionIf* MotionIf::getNew()
+MotionIf* MotionIf::getNew(MotionEngine engine)
 {
+	if (engine == MotionEngine::COMPLEMENTARY)
+	{
+		return newComplementaryMotion();
+	}
 	return new MotionImpl();
 }
\ No newline at end of file
@@ -42,6 +42,9 @@ typedef struct
 
 struct ControllerDevice
 {
+	static constexpr size_t TRIGGER_PACKET_SIZE = sizeof(DS5EffectsState_t::rgucLeftTriggerEffect);
+	static constexpr array<uint8_t, TRIGGER_PACKET_SIZE> NO_TRIGGER_EFFECT = { 0x05 };
+
 	ControllerDevice(int id)
 	  : _has_accel(false)
 	  , _has_gyro(false)
@@ -140,6 +143,8 @@ struct ControllerDevice
 		_micLight = 0;
 		memset(&_leftTriggerEffect, 0, sizeof(_leftTriggerEffect));
 		memset(&_rightTriggerEffect, 0, sizeof(_rightTriggerEffect));
+		LoadTriggerEffect(_leftTriggerPacket.data(), &_leftTriggerEffect);
+		LoadTriggerEffect(_rightTriggerPacket.data(), &_rightTriggerEffect);
 		_big_rumble = 0;
 		_small_rumble = 0;
 		SendEffect();
@@ -151,10 +156,12 @@ struct ControllerDevice
 		return _sdlController != nullptr;
 	}
 
-private:
-	void LoadTriggerEffect(uint8_t *rgucTriggerEffect, const AdaptiveTriggerSetting *trigger_effect)
+	// Encode the effect in the 11 bytes the controller expects. Some of the generators allocate,
+	// so this is only done when the effect changes and the result is copied in every packet.
+	static void LoadTriggerEffect(uint8_t *rgucTriggerEffect, const AdaptiveTriggerSetting *trigger_effect)
 	{
 		using namespace ExtendInput::DataTools::DualSense;
+		memset(rgucTriggerEffect, 0, TRIGGER_PACKET_SIZE);
 		rgucTriggerEffect[0] = (uint8_t)trigger_effect->mode;
 		switch (trigger_effect->mode)
 		{
@@ -201,8 +208,8 @@ public:
 
 			// Add adaptive trigger data
 			effectPacket.ucEnableBits1 |= 0x08 | 0x04; // Enable left and right trigger effect respectively
-			LoadTriggerEffect(effectPacket.rgucLeftTriggerEffect, &_leftTriggerEffect);
-			LoadTriggerEffect(effectPacket.rgucRightTriggerEffect, &_rightTriggerEffect);
+			memcpy(effectPacket.rgucLeftTriggerEffect, _leftTriggerPacket.data(), TRIGGER_PACKET_SIZE);
+			memcpy(effectPacket.rgucRightTriggerEffect, _rightTriggerPacket.data(), TRIGGER_PACKET_SIZE);
 
 			// Add current rumbling data
 			effectPacket.ucEnableBits1 |= 0x01 | 0x02;
@@ -226,11 +233,32 @@ public:
 	uint16_t _big_rumble = 0;
 	AdaptiveTriggerSetting _leftTriggerEffect;
 	AdaptiveTriggerSetting _rightTriggerEffect;
+	array<uint8_t, TRIGGER_PACKET_SIZE> _leftTriggerPacket = NO_TRIGGER_EFFECT;
+	array<uint8_t, TRIGGER_PACKET_SIZE> _rightTriggerPacket = NO_TRIGGER_EFFECT;
 	uint8_t _micLight = 0;
 	SDL_Gamepad *_sdlController = nullptr;
 	TOUCH_STATE _prevTouchState;
 };
 
+// Analog trigger positions from the axis events of one gamepad, oldest first.
+// The oldest are dropped if nobody collects them.
+struct TriggerReports
+{
+	static constexpr int MAX_REPORTS = 32;
+	array<float, MAX_REPORTS> positions;
+	int count = 0;
+
+	void add(float position)
+	{
+		if (count == MAX_REPORTS)
+		{
+			copy(positions.begin() + 1, positions.end(), positions.begin());
+			--count;
+		}
+		positions[count++] = position;
+	}
+};
+
 struct SdlInstance : public JslWrapper
 {
 public:
@@ -250,13 +278,36 @@ public:
 		SDL_SetHint(SDL_HINT_JOYSTICK_ENHANCED_REPORTS, "1");
 		SDL_SetHint(SDL_HINT_JOYSTICK_THREAD, "1");
 		SDL_Init(SDL_INIT_GAMEPAD);
+		SDL_AddEventWatch(&SdlInstance::watchTriggers, this);
 	}
 
 	virtual ~SdlInstance()
 	{
+		SDL_RemoveEventWatch(&SdlInstance::watchTriggers, this);
 		SDL_Quit();
 	}
 
+	// SDL sends an axis event for every report that moves a trigger, while the poll thread only sees
+	// the latest state each tick. Keep them for the hair trigger. This can run on SDL's joystick thread.
+	static bool SDLCALL watchTriggers(void *userdata, SDL_Event *event)
+	{
+		if (event->type == SDL_EVENT_GAMEPAD_AXIS_MOTION &&
+		  (event->gaxis.axis == SDL_GAMEPAD_AXIS_LEFT_TRIGGER || event->gaxis.axis == SDL_GAMEPAD_AXIS_RIGHT_TRIGGER))
+		{
+			auto this_ = static_cast<SdlInstance *>(userdata);
+			lock_guard guard(this_->trigger_lock);
+			int side = event->gaxis.axis == SDL_GAMEPAD_AXIS_LEFT_TRIGGER ? 0 : 1;
+			this_->_triggerReports[event->gaxis.which][side].add(event->gaxis.value / (float)(SDL_JOYSTICK_AXIS_MAX));
+		}
+		else if (event->type == SDL_EVENT_GAMEPAD_REMOVED)
+		{
+			auto this_ = static_cast<SdlInstance *>(userdata);
+			lock_guard guard(this_->trigger_lock);
+			this_->_triggerReports.erase(event->gdevice.which);
+		}
+		return true;
+	}
+
 	int pollDevices()
 	{
 		while (keep_polling)
@@ -296,6 +347,8 @@ public:
 	void (*g_touch_callback)(int, TOUCH_STATE, TOUCH_STATE, float) = nullptr;
 	atomic_bool keep_polling = false;
 	mutex controller_lock;
+	map<SDL_JoystickID, array<TriggerReports, 2>> _triggerReports; // left and right
+	mutex trigger_lock;
 
 	int ConnectDevices() override
 	{
@@ -336,6 +389,10 @@ public:
 			delete iter->second;
 			iter = _controllerMap.erase(iter);
 		}
+		{
+			lock_guard triggerGuard(trigger_lock);
+			_triggerReports.clear();
+		}
 		for (int i = 0; i < size; i++)
 		{
 			ControllerDevice *device = new ControllerDevice(_joysticksArray[i]);
@@ -365,6 +422,10 @@ public:
 			delete iter->second;
 			iter = _controllerMap.erase(iter);
 		}
+		{
+			lock_guard triggerGuard(trigger_lock);
+			_triggerReports.clear();
+		}
 		SDL_free(_joysticksArray);
 		_joysticksArray = nullptr;
 		SDL_Delay(200);
@@ -710,6 +771,8 @@ public:
 			// Update active trigger effect
 			_controllerMap[deviceId]->_leftTriggerEffect = _leftTriggerEffect;
 			_controllerMap[deviceId]->_rightTriggerEffect = _rightTriggerEffect;
+			ControllerDevice::LoadTriggerEffect(_controllerMap[deviceId]->_leftTriggerPacket.data(), &_leftTriggerEffect);
+			ControllerDevice::LoadTriggerEffect(_controllerMap[deviceId]->_rightTriggerPacket.data(), &_rightTriggerEffect);
 		}
 		_controllerMap[deviceId]->SendEffect();
 	}
@@ -723,6 +786,39 @@ public:
 			_controllerMap[deviceId]->SendEffect();
 		}
 	}
+
+	int GetTriggerHistory(int deviceId, bool isLeft, float *positions, int maxPositions) override
+	{
+		SDL_JoystickID id = SDL_GetGamepadID(_controllerMap[deviceId]->_sdlController);
+		lock_guard guard(trigger_lock);
+		TriggerReports &reports = _triggerReports[id][isLeft ? 0 : 1];
+		int count = min(reports.count, maxPositions);
+		copy(reports.positions.begin() + reports.count - count, reports.positions.begin() + reports.count, positions);
+		reports.count = 0;
+		return count;
+	}
+
+	void ClearTriggerHistory(int deviceId) override
+	{
+		SDL_JoystickID id = SDL_GetGamepadID(_controllerMap[deviceId]->_sdlController);
+		lock_guard guard(trigger_lock);
+		_triggerReports.erase(id);
+	}
+
+	std::string GetDeviceIdentifier(int deviceId) override
+	{
+		auto *gamepad = _controllerMap[deviceId]->_sdlController;
+		const char *serial = SDL_GetGamepadSerial(gamepad);
+		if (serial == nullptr || *serial == '\0')
+		{
+			return std::string(); // VID and PID alone can't tell two identical controllers apart
+		}
+		char vidPid[16];
+		SDL_snprintf(vidPid, sizeof(vidPid), "%04x:%04x:", SDL_GetGamepadVendor(gamepad), SDL_GetGamepadProduct(gamepad));
+		std::string identifier = std::string(vidPid) + serial;
+		replace(identifier.begin(), identifier.end(), ' ', '_'); // Keep the cache file whitespace separated
+		return identifier;
+	}
 };
 
 JslWrapper *JslWrapper::getNew()
@@ -1,6 +1,7 @@
 #include <cmath>
 #include "Stick.h"
 #include "JSMVariable.hpp"
+#include "InputHelpers.h"
 
 extern vector<JSMButton> grid_mappings;
 extern vector<JSMButton> mappings;
@@ -79,6 +80,19 @@ void ScrollAxis::processScroll(float distance, float sens, chrono::steady_clock:
 	// else do nothing and accumulate leftovers
 }
 
+void ScrollAxis::processHiResScroll(float distance, float sens, chrono::steady_clock::time_point now)
+{
+	if (_pressedBtn != ButtonID::NONE)
+	{
+		reset(now); // Don't leave a pulse hanging when switching over
+	}
+	if (sens <= 0.f)
+	{
+		return; // No notch to scale by: scroll nothing
+	}
+	scrollMouse(distance / sens);
+}
+
 void ScrollAxis::reset(chrono::steady_clock::time_point now)
 {
 	_leftovers = 0;
@@ -103,3 +117,88 @@ TouchStick::TouchStick(int index, shared_ptr<DigitalButton::Context> common, int
 	buttons.emplace(ButtonID::TRING, DigitalButton(common, mappings[int(ButtonID::TRING)]));
 }
 
+
+PowerCurve::PowerCurve()
+{
+	for (int i = 0; i < TABLE_SIZE; ++i)
+	{
+		_values[i] = float(i) / (TABLE_SIZE - 1);
+	}
+}
+
+void PowerCurve::setExponent(float exponent)
+{
+	if (exponent == _exponent)
+		return;
+
+	_exponent = exponent;
+	for (int i = 0; i < TABLE_SIZE; ++i)
+	{
+		_values[i] = pow(float(i) / (TABLE_SIZE - 1), exponent);
+	}
+}
+
+void StickResponse::update(float undeadzoneInner, float undeadzoneOuter, float unpower)
+{
+	_undeadzoneInner = undeadzoneInner;
+	_livezoneSize = 1.f - undeadzoneOuter - undeadzoneInner;
+	if (unpower == 0.f)
+		unpower = 1.f;
+	_power.setExponent(unpower);
+	_unpower.setExponent(1.f / unpower);
+}
+
+void HybridAimFilter::push(const Sample &sample, float deltaTime, float window)
+{
+	_time += deltaTime;
+	if (_count == MAX_SAMPLES)
+	{
+		add(_samples[_front], -1.);
+		_front = (_front + 1) % MAX_SAMPLES;
+		--_count;
+	}
+	int back = (_front + _count) % MAX_SAMPLES;
+	_samples[back] = sample;
+	_times[back] = _time;
+	++_count;
+	add(sample, 1.);
+
+	while (_count > 1 && _time - _times[_front] >= window)
+	{
+		add(_samples[_front], -1.);
+		_front = (_front + 1) % MAX_SAMPLES;
+		--_count;
+	}
+	if (_count == 1)
+	{
+		// Start over from the exact values
+		_sumVelocityX = sample.velocityX;
+		_sumVelocityY = sample.velocityY;
+		_sumOutputX = sample.outputX;
+		_sumOutputY = sample.outputY;
+		_sumOutputRadial = sample.outputRadial;
+	}
+}
+
+HybridAimFilter::Sample HybridAimFilter::average() const
+{
+	Sample average;
+	if (_count > 0)
+	{
+		average.velocityX = float(_sumVelocityX / _count);
+		average.velocityY = float(_sumVelocityY / _count);
+		average.outputX = float(_sumOutputX / _count);
+		average.outputY = float(_sumOutputY / _count);
+		average.outputRadial = float(_sumOutputRadial / _count);
+	}
+	return average;
+}
+
+void HybridAimFilter::add(const Sample &sample, double sign)
+{
+	_sumVelocityX += sign * sample.velocityX;
+	_sumVelocityY += sign * sample.velocityY;
+	_sumOutputX += sign * sample.outputX;
+	_sumOutputY += sign * sample.outputY;
+	_sumOutputRadial += sign * sample.outputRadial;
+}
@@ -0,0 +1,185 @@
+#include "TriggerCalibration.h"
+#include "JoyShock.h"
+#include <algorithm>
+
+namespace JSM
+{
+
+TriggerCalibration::TriggerCalibration(shared_ptr<JslWrapper> joyshock)
+  : PollingThread("Trigger calibration thread", std::bind(&TriggerCalibration::TriggerCalibrationPoll, this, std::placeholders::_1), nullptr, 5, false)
+  , jsl(joyshock)
+  , _handle(-1)
+{
+}
+
+TriggerCalibration::~TriggerCalibration()
+{
+	Join(); // The loop uses the device being calibrated
+}
+
+bool TriggerCalibration::start(shared_ptr<JoyShock> jc)
+{
+	if (isRunning())
+	{
+		CERR << "The triggers of device " << _handle << " are already being calibrated\n";
+		return false;
+	}
+	_jc = jc;
+	_handle = jc->_handle; // From here on the poll callback leaves the trigger effects alone
+	_step = Step::WAIT_RIGHT;
+	_settled = chrono::steady_clock::now();
+	{
+		lock_guard guard(jc->_context->callback_lock);
+		jc->_rightEffect.mode = AdaptiveTriggerMode::SEGMENT;
+		jc->_rightEffect.start = 0;
+		jc->_rightEffect.end = 255;
+		jc->_rightEffect.force = 255;
+		jsl->SetTriggerEffect(jc->_handle, jc->_leftEffect, jc->_rightEffect);
+	}
+	COUT << "Calibrating the triggers of device " << jc->_handle << ".\n";
+	COUT << "Softly press on the right trigger until you just feel the resistance.\n";
+	COUT << "Then press the dpad down button to proceed, or press HOME to abandon.\n";
+	return Start();
+}
+
+bool TriggerCalibration::isCalibrating(int handle)
+{
+	return _handle == handle && isRunning();
+}
+
+bool TriggerCalibration::bisect(bool found)
+{
+	int position = (_low + _high) / 2;
+	DEBUG_LOG << "trigger is " << (found ? "past" : "short of") << " the target with effect pos at " << position << '\n';
+	if (found)
+		_high = position;
+	else
+		_low = min(position + 1, _high);
+	return _low >= _high;
+}
+
+void TriggerCalibration::probe(AdaptiveTriggerSetting &effect, int position)
+{
+	effect.start = position;
+	jsl->SetTriggerEffect(_jc->_handle, _jc->_leftEffect, _jc->_rightEffect);
+	_settled = chrono::steady_clock::now() + SETTLE_TIME;
+}
+
+bool TriggerCalibration::isConnected()
+{
+	vector<int> handles(jsl->GetDeviceCount());
+	if (!handles.empty())
+	{
+		handles.resize(max(0, jsl->GetConnectedDeviceHandles(handles.data(), int(handles.size()))));
+	}
+	return ranges::find(handles, _jc->_handle) != handles.end();
+}
+
+void TriggerCalibration::finish()
+{
+	_handle = -1;
+	Stop();
+}
+
+bool TriggerCalibration::TriggerCalibrationPoll(void *param)
+{
+	auto jc = _jc; // Keep the device alive until this poll returns
+	if (!isConnected())
+	{
+		CERR << "Device " << jc->_handle << " was disconnected during calibration\n";
+		finish();
+		return true;
+	}
+	int buttons = jsl->GetButtons(jc->_handle);
+	if (buttons & (1 << JSOFFSET_HOME))
+	{
+		COUT << "Abandonning calibration\n";
+		finish();
+		return true;
+	}
+	if (chrono::steady_clock::now() < _settled)
+	{
+		return true;
+	}
+
+	lock_guard guard(jc->_context->callback_lock);
+	switch (_step)
+	{
+	case Step::WAIT_RIGHT:
+		if (buttons & (1 << JSOFFSET_DOWN))
+		{
+			_low = 0;
+			_high = 255;
+			_step = Step::RIGHT_OFFSET;
+			probe(jc->_rightEffect, (_low + _high) / 2);
+		}
+		break;
+	case Step::RIGHT_OFFSET:
+		if (bisect(int(jsl->GetRightTrigger(jc->_handle) * 255.f) > 0))
+		{
+			// The trigger can only reach full pull past the offset
+			_offset = _low;
+			_high = 255;
+			_step = Step::RIGHT_END;
+		}
+		probe(jc->_rightEffect, (_low + _high) / 2);
+		break;
+	case Step::RIGHT_END:
+		if (bisect(int(jsl->GetRightTrigger(jc->_handle) * 255.f) == 255))
+		{
+			SettingsManager::getV<int>(SettingID::RIGHT_TRIGGER_OFFSET)->set(_offset);
+			SettingsManager::getV<int>(SettingID::RIGHT_TRIGGER_RANGE)->set(_low - _offset);
+			jc->_leftEffect.mode = AdaptiveTriggerMode::SEGMENT;
+			jc->_leftEffect.start = 0;
+			jc->_leftEffect.end = 255;
+			jc->_leftEffect.force = 255;
+			jsl->SetTriggerEffect(jc->_handle, jc->_leftEffect, jc->_rightEffect);
+			_step = Step::WAIT_LEFT;
+			COUT << "Softly press on the left trigger until you just feel the resistance.\n";
+			COUT << "Then press the cross button to proceed, or press HOME to abandon.\n";
+		}
+		else
+		{
+			probe(jc->_rightEffect, (_low + _high) / 2);
+		}
+		break;
+	case Step::WAIT_LEFT:
+		if (buttons & (1 << JSOFFSET_S))
+		{
+			_low = 0;
+			_high = 255;
+			_step = Step::LEFT_OFFSET;
+			probe(jc->_leftEffect, (_low + _high) / 2);
+		}
+		break;
+	case Step::LEFT_OFFSET:
+		if (bisect(int(jsl->GetLeftTrigger(jc->_handle) * 255.f) > 0))
+		{
+			_offset = _low;
+			_high = 255;
+			_step = Step::LEFT_END;
+		}
+		probe(jc->_leftEffect, (_low + _high) / 2);
+		break;
+	case Step::LEFT_END:
+		if (bisect(int(jsl->GetLeftTrigger(jc->_handle) * 255.f) == 255))
+		{
+			SettingsManager::getV<int>(SettingID::LEFT_TRIGGER_OFFSET)->set(_offset);
+			SettingsManager::getV<int>(SettingID::LEFT_TRIGGER_RANGE)->set(_low - _offset);
+			COUT << "The triggers of device " << jc->_handle << " have been successfully calibrated. If it is your only dualsense, add the trigger offset and range values in your OnReset.txt file to have those values set by default.\n";
+			COUT_INFO << SettingID::RIGHT_TRIGGER_OFFSET << " = " << SettingsManager::getV<int>(SettingID::RIGHT_TRIGGER_OFFSET)->value() << '\n';
+			COUT_INFO << SettingID::RIGHT_TRIGGER_RANGE << " = " << SettingsManager::getV<int>(SettingID::RIGHT_TRIGGER_RANGE)->value() << '\n';
+			COUT_INFO << SettingID::LEFT_TRIGGER_OFFSET << " = " << SettingsManager::getV<int>(SettingID::LEFT_TRIGGER_OFFSET)->value() << '\n';
+			COUT_INFO << SettingID::LEFT_TRIGGER_RANGE << " = " << SettingsManager::getV<int>(SettingID::LEFT_TRIGGER_RANGE)->value() << '\n';
+			finish();
+		}
+		else
+		{
+			probe(jc->_leftEffect, (_low + _high) / 2);
+		}
+		break;
+	}
+	return true;
+}
+
+} // namespace JSM
@@ -12,6 +12,9 @@
 #include <iostream>
 
 #include <libevdev/libevdev-uinput.h>
+#ifndef REL_WHEEL_HI_RES
+#define REL_WHEEL_HI_RES 0x0b // Linux 5.0
+#endif
 #include <fcntl.h>
 
 #include <dirent.h>
@@ -334,6 +337,7 @@ public:
 			libevdev_enable_event_code(device_, EV_REL, REL_X, nullptr);
 			libevdev_enable_event_code(device_, EV_REL, REL_Y, nullptr);
 			libevdev_enable_event_code(device_, EV_REL, REL_WHEEL, nullptr);
+			libevdev_enable_event_code(device_, EV_REL, REL_WHEEL_HI_RES, nullptr);
 
 			libevdev_enable_event_type(device_, EV_ABS);
 			libevdev_enable_event_code(device_, EV_ABS, ABS_X, nullptr);
@@ -462,15 +466,26 @@ public:
 		}
 	}
 
-	void mouse_scroll(std::int32_t amount) noexcept
+	// hiResAmount is in 120ths of a notch. Listeners of the legacy wheel need the whole notches as well.
+	void mouse_scroll_hi_res(std::int32_t hiResAmount, std::int32_t notches) noexcept
 	{
-		auto error = libevdev_uinput_write_event(uinput_device_, EV_REL, REL_WHEEL, amount);
+		auto error = libevdev_uinput_write_event(uinput_device_, EV_REL, REL_WHEEL_HI_RES, hiResAmount);
 		if (error != 0)
 		{
 			std::fprintf(stderr, "Failed to to simulate mouse scroll: %s\n", std::strerror(-error));
 			return;
 		}
 
+		if (notches != 0)
+		{
+			error = libevdev_uinput_write_event(uinput_device_, EV_REL, REL_WHEEL, notches);
+			if (error != 0)
+			{
+				std::fprintf(stderr, "Failed to to simulate mouse scroll: %s\n", std::strerror(-error));
+				return;
+			}
+		}
+
 		error = libevdev_uinput_write_event(uinput_device_, EV_SYN, SYN_REPORT, 0);
 		if (error != 0)
 		{
@@ -479,6 +494,12 @@ public:
 		}
 	}
 
+	void mouse_scroll(std::int32_t amount) noexcept
+	{
+		// Readers that support the high resolution wheel ignore REL_WHEEL, so whole notches go on both
+		mouse_scroll_hi_res(amount * 120, amount);
+	}
+
 private:
 	libevdev *device_;
 	libevdev_uinput *uinput_device_{ nullptr };
@@ -558,9 +579,11 @@ int pressKey(KeyCode vkKey, bool pressed)
 
 float accumulatedX = 0;
 float accumulatedY = 0;
+static std::mutex accumulatedLock; // the flick output thread moves the mouse too
 
 void moveMouse(float x, float y)
 {
+	std::lock_guard guard(accumulatedLock);
 	accumulatedX += x;
 	accumulatedY += y;
 
@@ -579,6 +602,24 @@ void setMouseNorm(float x, float y)
 	mouse.mouse_move_absolute(std::roundf(65535.0f * x), std::roundf(65535.0f * y));
 }
 
+float accumulatedScroll = 0; // in 120ths of a notch
+int accumulatedHiResScroll = 0; // sent but not yet reported as a whole notch
+
+void scrollMouse(float notches)
+{
+	std::lock_guard guard(accumulatedLock);
+	accumulatedScroll += notches * 120.f;
+	int applicableScroll = (int)accumulatedScroll;
+	accumulatedScroll -= applicableScroll;
+	if (applicableScroll != 0)
+	{
+		accumulatedHiResScroll += applicableScroll;
+		int wholeNotches = accumulatedHiResScroll / 120;
+		accumulatedHiResScroll -= wholeNotches * 120;
+		mouse.mouse_scroll_hi_res(applicableScroll, wholeNotches);
+	}
+}
+
 bool WriteToConsole(string_view command)
 {
 	std::lock_guard<std::mutex> lock(commandQueueMutex);
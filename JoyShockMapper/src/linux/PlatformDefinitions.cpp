@@ -20,37 +20,33 @@
 #define FOREGROUND_INTENSITY 0x0100 // text color is bold.
 #define DEFAULT_COLOR 37 // text color is white
 
-template<std::ostream *stdio, uint16_t color>
-struct ColorStream : public std::stringbuf
+static void printColor(std::ostream &stdio, uint16_t color, string_view text)
 {
-	~ColorStream()
-	{
-
-		(*stdio) << "\033[" << (color >> 8) << ';' << (color & 0x00FF) << 'm' << str() << "\033[0;" << DEFAULT_COLOR << 'm';
-	}
-};
+	stdio << "\033[" << (color >> 8) << ';' << (color & 0x00FF) << 'm' << text << "\033[0;" << DEFAULT_COLOR << 'm';
+}
 
-streambuf *Log::makeBuffer(Level level)
+void Log::print(Level level, string_view text)
 {
 	switch (level)
 	{
 	case Level::ERR:
-		return new ColorStream<&std::cerr, FOREGROUND_RED | FOREGROUND_INTENSITY>();
+		printColor(std::cerr, FOREGROUND_RED | FOREGROUND_INTENSITY, text);
+		break;
 	case Level::WARN:
-		return new ColorStream<&cout, FOREGROUND_YELLOW | FOREGROUND_INTENSITY>();
+		printColor(cout, FOREGROUND_YELLOW | FOREGROUND_INTENSITY, text);
+		break;
 	case Level::INFO:
-		return new ColorStream<&cout, FOREGROUND_BLUE | FOREGROUND_INTENSITY>();
-#if defined(NDEBUG) // release
-	case Level::UT:
-		return new NullBuffer(); // unused
-#else
+		printColor(cout, FOREGROUND_BLUE | FOREGROUND_INTENSITY, text);
+		break;
 	case Level::UT:
-		return new ColorStream<&cout, FOREGROUND_BLUE | FOREGROUND_RED>(); // purplish
-#endif
+		printColor(cout, FOREGROUND_BLUE | FOREGROUND_RED, text); // purplish
+		break;
 	case Level::BOLD:
-		return new ColorStream<&cout, FOREGROUND_GREEN | FOREGROUND_INTENSITY>();
+		printColor(cout, FOREGROUND_GREEN | FOREGROUND_INTENSITY, text);
+		break;
 	default:
-		return new ColorStream<&std::cout, FOREGROUND_GREEN>();
+		printColor(std::cout, FOREGROUND_GREEN, text);
+		break;
 	}
 }
 
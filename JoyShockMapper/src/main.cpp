@@ -10,6 +10,10 @@
 #include "AutoConnect.h"
 #include "SettingsManager.h"
 #include "JoyShock.h"
+#include "CalibrationCache.h"
+#include "FlickOutput.h"
+#include "TriggerCalibration.h"
+#include "ButtonReplay.h"
 #include <filesystem>
 #define _USE_MATH_DEFINES
 #include <math.h> // M_PI
@@ -37,11 +41,13 @@ float last_flick_and_rotation = 0.0;
 unique_ptr<PollingThread> autoLoadThread;
 unique_ptr<JSM::AutoConnect> autoConnectThread;
 unique_ptr<PollingThread> minimizeThread;
+unique_ptr<JSM::CalibrationCache> calibrationCache;
+unique_ptr<JSM::FlickOutput> flickOutput;
+unique_ptr<JSM::TriggerCalibration> triggerCalibration;
 bool devicesCalibrating = false;
 unordered_map<int, shared_ptr<JoyShock>> handle_to_joyshock;
 
 int input_pipe_fd[2];
-int triggerCalibrationStep = 0;
 
 struct TOUCH_POINT
 {
@@ -89,6 +95,7 @@ struct TOUCH_POINT
 
 void touchCallback(int jcHandle, TOUCH_STATE newState, TOUCH_STATE prevState, float delta_time)
 {
+	Log::setHotThread();
 
 	// if (current.t0Down || previous.t0Down)
 	//{
@@ -123,17 +130,10 @@ void touchCallback(int jcHandle, TOUCH_STATE newState, TOUCH_STATE prevState, fl
 	if (!point0.isDown() && !point1.isDown())
 	{
 
-		static const function<bool(ButtonID)> IS_TOUCH_BUTTON = [](ButtonID id)
-		{
-			return id >= ButtonID::T1;
-		};
-
-		for (auto currentlyActive = find_if(js->_context->chordStack.begin(), js->_context->chordStack.end(), IS_TOUCH_BUTTON);
-		     currentlyActive != js->_context->chordStack.end();
-		     currentlyActive = find_if(js->_context->chordStack.begin(), js->_context->chordStack.end(), IS_TOUCH_BUTTON))
-		{
-			js->_context->chordStack.erase(currentlyActive);
-		}
+		js->_context->chordStack.erase_if([](ButtonID id)
+		  {
+			  return id >= ButtonID::T1;
+		  });
 	}
 	if (mode == TouchpadMode::GRID_AND_STICK)
 	{
@@ -223,151 +223,42 @@ void touchCallback(int jcHandle, TOUCH_STATE newState, TOUCH_STATE prevState, fl
 	}
 }
 
-void calibrateTriggers(shared_ptr<JoyShock> jc)
-{
-	if (jsl->GetButtons(jc->_handle) & (1 << JSOFFSET_HOME))
-	{
-		COUT << "Abandonning calibration\n";
-		triggerCalibrationStep = 0;
-		return;
-	}
-
-	auto rpos = jsl->GetRightTrigger(jc->_handle);
-	auto lpos = jsl->GetLeftTrigger(jc->_handle);
-	auto tick_time = *SettingsManager::get<float>(SettingID::TICK_TIME);
-	static auto &right_trigger_offset = *SettingsManager::getV<int>(SettingID::RIGHT_TRIGGER_OFFSET);
-	static auto &right_trigger_range = *SettingsManager::getV<int>(SettingID::RIGHT_TRIGGER_RANGE);
-	static auto &left_trigger_offset = *SettingsManager::getV<int>(SettingID::LEFT_TRIGGER_OFFSET);
-	static auto &left_trigger_range = *SettingsManager::getV<int>(SettingID::LEFT_TRIGGER_RANGE);
-	switch (triggerCalibrationStep)
-	{
-	case 1:
-		COUT << "Softly press on the right trigger until you just feel the resistance.\n";
-		COUT << "Then press the dpad down button to proceed, or press HOME to abandon.\n";
-		tick_time.set(100.f);
-		jc->_rightEffect.mode = AdaptiveTriggerMode::SEGMENT;
-		jc->_rightEffect.start = 0;
-		jc->_rightEffect.end = 255;
-		jc->_rightEffect.force = 255;
-		triggerCalibrationStep++;
-		break;
-	case 2:
-		if (jsl->GetButtons(jc->_handle) & (1 << JSOFFSET_DOWN))
-		{
-			triggerCalibrationStep++;
-		}
-		break;
-	case 3:
-		DEBUG_LOG << "trigger pos is at " << int(rpos * 255.f) << " (" << int(rpos * 100.f) << "%) and effect pos is at " << int(jc->_rightEffect.start) << '\n';
-		if (int(rpos * 255.f) > 0)
-		{
-			right_trigger_offset.set(jc->_rightEffect.start);
-			tick_time.set(40);
-			triggerCalibrationStep++;
-		}
-		++jc->_rightEffect.start;
-		break;
-	case 4:
-		DEBUG_LOG << "trigger pos is at " << int(rpos * 255.f) << " (" << int(rpos * 100.f) << "%) and effect pos is at " << int(jc->_rightEffect.start) << '\n';
-		if (int(rpos * 255.f) > 240)
-		{
-			tick_time.set(100);
-			triggerCalibrationStep++;
-		}
-		++jc->_rightEffect.start;
-		break;
-	case 5:
-		DEBUG_LOG << "trigger pos is at " << int(rpos * 255.f) << " (" << int(rpos * 100.f) << "%) and effect pos is at " << int(jc->_rightEffect.start) << '\n';
-		if (int(rpos * 255.f) == 255)
-		{
-			triggerCalibrationStep++;
-			right_trigger_range.set(int(jc->_rightEffect.start - right_trigger_offset));
-		}
-		++jc->_rightEffect.start;
-		break;
-	case 6:
-		COUT << "Softly press on the left trigger until you just feel the resistance.\n";
-		COUT << "Then press the cross button to proceed, or press HOME to abandon.\n";
-		tick_time.set(100);
-		jc->_leftEffect.mode = AdaptiveTriggerMode::SEGMENT;
-		jc->_leftEffect.start = 0;
-		jc->_leftEffect.end = 255;
-		jc->_leftEffect.force = 255;
-		triggerCalibrationStep++;
-		break;
-	case 7:
-		if (jsl->GetButtons(jc->_handle) & (1 << JSOFFSET_S))
-		{
-			triggerCalibrationStep++;
-		}
-		break;
-	case 8:
-		DEBUG_LOG << "trigger pos is at " << int(lpos * 255.f) << " (" << int(lpos * 100.f) << "%) and effect pos is at " << int(jc->_leftEffect.start) << '\n';
-		if (int(lpos * 255.f) > 0)
-		{
-			left_trigger_offset.set(jc->_leftEffect.start);
-			tick_time.set(40);
-			triggerCalibrationStep++;
-		}
-		++jc->_leftEffect.start;
-		break;
-	case 9:
-		DEBUG_LOG << "trigger pos is at " << int(lpos * 255.f) << " (" << int(lpos * 100.f) << "%) and effect pos is at " << int(jc->_leftEffect.start) << '\n';
-		if (int(lpos * 255.f) > 240)
-		{
-			tick_time.set(100);
-			triggerCalibrationStep++;
-		}
-		++jc->_leftEffect.start;
-		break;
-	case 10:
-		DEBUG_LOG << "trigger pos is at " << int(lpos * 255.f) << " (" << int(lpos * 100.f) << "%) and effect pos is at " << int(jc->_leftEffect.start) << '\n';
-		if (int(lpos * 255.f) == 255)
-		{
-			triggerCalibrationStep++;
-			left_trigger_range.set(int(jc->_leftEffect.start - left_trigger_offset));
-		}
-		++jc->_leftEffect.start;
-		break;
-	case 11:
-		COUT << "Your triggers have been successfully calibrated. Add the trigger offset and range values in your OnReset.txt file to have those values set by default.\n";
-		COUT_INFO << SettingID::RIGHT_TRIGGER_OFFSET << " = " << right_trigger_offset << '\n';
-		COUT_INFO << SettingID::RIGHT_TRIGGER_RANGE << " = " << right_trigger_range << '\n';
-		COUT_INFO << SettingID::LEFT_TRIGGER_OFFSET << " = " << left_trigger_offset << '\n';
-		COUT_INFO << SettingID::LEFT_TRIGGER_RANGE << " = " << left_trigger_range << '\n';
-		triggerCalibrationStep = 0;
-		tick_time.reset();
-		break;
-	}
-	jsl->SetTriggerEffect(jc->_handle, jc->_leftEffect, jc->_rightEffect);
-}
-
 void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE lastState, IMU_STATE imuState, IMU_STATE lastImuState, float deltaTime)
 {
+	Log::setHotThread();
 
 	shared_ptr<JoyShock> jc = handle_to_joyshock[jcHandle];
 	if (jc == nullptr)
 		return;
 	jc->_context->callback_lock.lock();
 
+	// Measured from the previous report, processed or not, so that motion and the mouse never get a catch up step
 	auto timeNow = chrono::steady_clock::now();
 	deltaTime = ((float)chrono::duration_cast<chrono::microseconds>(timeNow - jc->_timeNow).count()) / 1000000.0f;
 	jc->_timeNow = timeNow;
 
-	if (triggerCalibrationStep)
+	if (triggerCalibration->isCalibrating(jc->_handle))
 	{
-		calibrateTriggers(jc);
+		// The calibration thread drives this controller's trigger effects
+		jsl->ClearTriggerHistory(jc->_handle);
 		jc->_context->callback_lock.unlock();
 		return;
 	}
 
-	MotionIf &motion = *jc->_motion;
-
 	IMU_STATE imu = jsl->GetIMUState(jc->_handle);
 
+	if (jc->skipIdlePoll(imu, timeNow))
+	{
+		jsl->ClearTriggerHistory(jc->_handle);
+		jc->_context->callback_lock.unlock();
+		return;
+	}
+
+	MotionIf &motion = *jc->_motion;
+
 	if (SettingsManager::getV<Switch>(SettingID::AUTO_CALIBRATE_GYRO)->value() == Switch::ON)
 	{
-		motion.SetAutoCalibration(true, 1.2f, 0.015f);
+		motion.SetAutoCalibration(true, MAGIC_STILLNESS_GYRO_DELTA, MAGIC_STILLNESS_ACCEL_DELTA);
 	}
 	else
 	{
@@ -428,10 +319,7 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 		Quat neutralQuat = Quat(cosf(diffAngle * 0.5f), neutralGravAxis.x, neutralGravAxis.y, neutralGravAxis.z);
 		neutralQuat.Normalize();
 
-		jc->neutralQuatW = neutralQuat.w;
-		jc->neutralQuatX = neutralQuat.x;
-		jc->neutralQuatY = neutralQuat.y;
-		jc->neutralQuatZ = neutralQuat.z;
+		jc->neutralInverse = RotationMatrix(neutralQuat.Inverse());
 		jc->set_neutral_quat = false;
 		COUT << "Neutral orientation for device " << jc->_handle << " set...\n";
 	}
@@ -602,9 +490,16 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 	if (numGyroSamples < 1)
 		numGyroSamples = 1; // need at least 1 sample
 	auto threshold = jc->getSetting(SettingID::GYRO_SMOOTH_THRESHOLD);
+	float rawGyroX = gyroX;
+	float rawGyroY = gyroY;
 	jc->getSmoothedGyro(gyroX, gyroY, gyroLength, threshold / 2.0f, threshold, int(numGyroSamples), gyroX, gyroY);
 	// COUT << "%d Samples for threshold: %0.4f\n", numGyroSamples, gyro_smooth_threshold * maxSmoothingSamples);
 
+	// compensate for latency by extrapolating where the gyro is heading
+	auto predictionTime = jc->getSetting(SettingID::GYRO_PREDICTION_TIME);
+	auto predictionCap = jc->getSetting(SettingID::GYRO_PREDICTION_CAP);
+	jc->predictGyro(rawGyroX, rawGyroY, deltaTime, predictionTime, predictionCap, gyroX, gyroY);
+
 	// now, honour gyro_cutoff_speed
 	gyroLength = sqrt(gyroX * gyroX + gyroY * gyroY);
 	auto speed = jc->getSetting(SettingID::GYRO_CUTOFF_SPEED);
@@ -721,39 +616,14 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 	}
 	break;
 	}
-	float gyro_x_sign_to_use = jc->getSetting(SettingID::GYRO_AXIS_X);
-	float gyro_y_sign_to_use = jc->getSetting(SettingID::GYRO_AXIS_Y);
+	// Apply the gyro actions in effect, as summarized whenever they change
+	const GyroModifiers &gyroModifiers = jc->_context->gyroModifiers;
+	blockGyro = gyroModifiers.blockGyro.value_or(blockGyro);
+	float gyro_x_sign_to_use = jc->getSetting(SettingID::GYRO_AXIS_X) * (gyroModifiers.invertX ? -1 : 1);
+	float gyro_y_sign_to_use = jc->getSetting(SettingID::GYRO_AXIS_Y) * (gyroModifiers.invertY ? -1 : 1);
 
-	bool trackball_x_pressed = false;
-	bool trackball_y_pressed = false;
-
-	// Apply gyro modifiers in the queue from oldest to newest (thus giving priority to most recent)
-	for (auto pair : jc->_context->gyroActionQueue)
-	{
-		if (pair.second.code == GYRO_ON_BIND)
-			blockGyro = false;
-		else if (pair.second.code == GYRO_OFF_BIND)
-			blockGyro = true;
-		else if (pair.second.code == GYRO_INV_X)
-			gyro_x_sign_to_use = jc->getSetting(SettingID::GYRO_AXIS_X) * -1; // Intentionally don't support multiple inversions
-		else if (pair.second.code == GYRO_INV_Y)
-			gyro_y_sign_to_use = jc->getSetting(SettingID::GYRO_AXIS_Y) * -1; // Intentionally don't support multiple inversions
-		else if (pair.second.code == GYRO_INVERT)
-		{
-			// Intentionally don't support multiple inversions
-			gyro_x_sign_to_use = jc->getSetting(SettingID::GYRO_AXIS_X) * -1;
-			gyro_y_sign_to_use = jc->getSetting(SettingID::GYRO_AXIS_Y) * -1;
-		}
-		else if (pair.second.code == GYRO_TRACK_X)
-			trackball_x_pressed = true;
-		else if (pair.second.code == GYRO_TRACK_Y)
-			trackball_y_pressed = true;
-		else if (pair.second.code == GYRO_TRACKBALL)
-		{
-			trackball_x_pressed = true;
-			trackball_y_pressed = true;
-		}
-	}
+	bool trackball_x_pressed = gyroModifiers.trackballX;
+	bool trackball_y_pressed = gyroModifiers.trackballY;
 
 	float decay = exp2f(-deltaTime * jc->getSetting(SettingID::TRACKBALL_DECAY));
 	int maxTrackballSamples = max(1, min(jc->NUM_LAST_GYRO_SAMPLES, (int)(1.f / deltaTime * 0.125f)));
@@ -819,37 +689,47 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 	float gyroXVelocity = gyroX * gyro_x_sign_to_use;
 	float gyroYVelocity = gyroY * gyro_y_sign_to_use;
 
-	pair<float, float> lowSensXY = jc->getSetting<FloatXY>(SettingID::MIN_GYRO_SENS);
-	pair<float, float> hiSensXY = jc->getSetting<FloatXY>(SettingID::MAX_GYRO_SENS);
-
 	// apply calibration factor
 	// get input velocity
 	float magnitude = sqrt(gyroX * gyroX + gyroY * gyroY);
 	// COUT << "Gyro mag: " << setprecision(4) << magnitude << '\n';
-	// calculate position on minThreshold to maxThreshold scale
-	float minThreshold = jc->getSetting(SettingID::MIN_GYRO_THRESHOLD);
-	float maxThreshold = jc->getSetting(SettingID::MAX_GYRO_THRESHOLD);
-	magnitude -= minThreshold;
-	if (magnitude < 0.0f)
-		magnitude = 0.0f;
-	float denom = maxThreshold - minThreshold;
-	float newSensitivity;
-	if (denom <= 0.0f)
-	{
-		newSensitivity =
-		  magnitude > 0.0f ? 1.0f : 0.0f; // if min threshold overlaps max threshold, pop up to
-		                                  // max lowSens as soon as we're above min threshold
+	GyroSensCurve sensCurve = jc->getSetting<GyroSensCurve>(SettingID::GYRO_SENS_CURVE);
+	if (!sensCurve.empty())
+	{
+		float curveSensitivity = sensCurve.evaluate(magnitude);
+		gyroXVelocity *= curveSensitivity;
+		gyroYVelocity *= curveSensitivity;
 	}
 	else
 	{
-		newSensitivity = magnitude / denom;
-	}
-	if (newSensitivity > 1.0f)
-		newSensitivity = 1.0f;
+		pair<float, float> lowSensXY = jc->getSetting<FloatXY>(SettingID::MIN_GYRO_SENS);
+		pair<float, float> hiSensXY = jc->getSetting<FloatXY>(SettingID::MAX_GYRO_SENS);
+
+		// calculate position on minThreshold to maxThreshold scale
+		float minThreshold = jc->getSetting(SettingID::MIN_GYRO_THRESHOLD);
+		float maxThreshold = jc->getSetting(SettingID::MAX_GYRO_THRESHOLD);
+		magnitude -= minThreshold;
+		if (magnitude < 0.0f)
+			magnitude = 0.0f;
+		float denom = maxThreshold - minThreshold;
+		float newSensitivity;
+		if (denom <= 0.0f)
+		{
+			newSensitivity =
+			  magnitude > 0.0f ? 1.0f : 0.0f; // if min threshold overlaps max threshold, pop up to
+			                                  // max lowSens as soon as we're above min threshold
+		}
+		else
+		{
+			newSensitivity = magnitude / denom;
+		}
+		if (newSensitivity > 1.0f)
+			newSensitivity = 1.0f;
 
-	// interpolate between low sensitivity and high sensitivity
-	gyroXVelocity *= lowSensXY.first * (1.0f - newSensitivity) + hiSensXY.first * newSensitivity;
-	gyroYVelocity *= lowSensXY.second * (1.0f - newSensitivity) + hiSensXY.second * newSensitivity;
+		// interpolate between low sensitivity and high sensitivity
+		gyroXVelocity *= lowSensXY.first * (1.0f - newSensitivity) + hiSensXY.first * newSensitivity;
+		gyroYVelocity *= lowSensXY.second * (1.0f - newSensitivity) + hiSensXY.second * newSensitivity;
+	}
 
 	jc->gyroXVelocity = gyroXVelocity;
 	jc->gyroYVelocity = gyroYVelocity;
@@ -861,16 +741,14 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 	ControllerOrientation controllerOrientation = jc->getSetting<ControllerOrientation>(SettingID::CONTROLLER_ORIENTATION);
 	// account for os mouse speed and convert from radians to degrees because gyro reports in degrees per second
 	float mouseCalibrationFactor = 180.0f / M_PI / os_mouse_speed;
+	JoyShock::StickBatch sticks;
 	if (jc->_splitType != JS_SPLIT_TYPE_RIGHT)
 	{
 		// let's do these sticks... don't want to constantly send input, so we need to compare them to last time
 		auto axisSign = jc->getSetting<AxisSignPair>(SettingID::LEFT_STICK_AXIS);
 		float calX = jsl->GetLeftX(jc->_handle) * float(axisSign.first);
 		float calY = jsl->GetLeftY(jc->_handle) * float(axisSign.second);
-
-		jc->processStick(calX, calY, jc->_leftStick, mouseCalibrationFactor, deltaTime, leftAny, lockMouse, camSpeedX, camSpeedY);
-		jc->_leftStick.lastX = calX;
-		jc->_leftStick.lastY = calY;
+		sticks.add(jc->_leftStick, calX, calY, leftAny);
 	}
 
 	if (jc->_splitType != JS_SPLIT_TYPE_LEFT)
@@ -878,22 +756,16 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 		auto axisSign = jc->getSetting<AxisSignPair>(SettingID::RIGHT_STICK_AXIS);
 		float calX = jsl->GetRightX(jc->_handle) * float(axisSign.first);
 		float calY = jsl->GetRightY(jc->_handle) * float(axisSign.second);
-
-		jc->processStick(calX, calY, jc->_rightStick, mouseCalibrationFactor, deltaTime, rightAny, lockMouse, camSpeedX, camSpeedY);
-		jc->_rightStick.lastX = calX;
-		jc->_rightStick.lastY = calY;
+		sticks.add(jc->_rightStick, calX, calY, rightAny);
 	}
 
-	if (jc->_splitType == JS_SPLIT_TYPE_FULL ||
-	  (jc->_splitType & (int)jc->getSetting<JoyconMask>(SettingID::JOYCON_MOTION_MASK)) == 0)
+	bool hasMotionStick = jc->_splitType == JS_SPLIT_TYPE_FULL ||
+	  (jc->_splitType & (int)jc->getSetting<JoyconMask>(SettingID::JOYCON_MOTION_MASK)) == 0;
+	Vec grav;
+	if (hasMotionStick)
 	{
-		Quat neutralQuat = Quat(jc->neutralQuatW, jc->neutralQuatX, jc->neutralQuatY, jc->neutralQuatZ);
-		Vec grav = Vec(inGravX, inGravY, inGravZ) * neutralQuat.Inverse();
+		grav = Vec(inGravX, inGravY, inGravZ) * jc->neutralInverse;
 
-		float lastCalX = jc->_motionStick.lastX;
-		float lastCalY = jc->_motionStick.lastY;
-		// float lastCalX = jc->_motionStick.lastX;
-		// float lastCalY = jc->_motionStick.lastY;
 		//  use gravity vector deflection
 		auto axisSign = jc->getSetting<AxisSignPair>(SettingID::MOTION_STICK_AXIS);
 		float calX = grav.x * float(axisSign.first);
@@ -905,11 +777,13 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 			calX *= gravStickDeflection / gravLength2D;
 			calY *= gravStickDeflection / gravLength2D;
 		}
+		sticks.add(jc->_motionStick, calX, calY, motionAny);
+	}
 
-		jc->processStick(calX, calY, jc->_motionStick, mouseCalibrationFactor, deltaTime, motionAny, lockMouse, camSpeedX, camSpeedY);
-		jc->_motionStick.lastX = calX;
-		jc->_motionStick.lastY = calY;
+	jc->processSticks(sticks, mouseCalibrationFactor, deltaTime, lockMouse, camSpeedX, camSpeedY);
 
+	if (hasMotionStick)
+	{
 		float gravLength3D = grav.Length();
 		if (gravLength3D > 0)
 		{
@@ -930,7 +804,7 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 				break;
 			}
 			float gravDirX = gravSideDir / gravLength3D;
-			float sinLeanThreshold = sin(jc->getSetting(SettingID::LEAN_THRESHOLD) * M_PI / 180.f);
+			float sinLeanThreshold = jc->getSinLeanThreshold();
 			jc->handleButtonChange(ButtonID::LEAN_LEFT, gravDirX < -sinLeanThreshold);
 			jc->handleButtonChange(ButtonID::LEAN_RIGHT, gravDirX > sinLeanThreshold);
 
@@ -948,36 +822,13 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 				}
 				float motionDZInner = jc->getSetting(SettingID::MOTION_DEADZONE_INNER);
 				float motionDZOuter = jc->getSetting(SettingID::MOTION_DEADZONE_OUTER);
-				float remappedLeanAngle = pow(clamp((absLeanAngle - motionDZInner) / (180.f - motionDZOuter - motionDZInner), 0.f, 1.f), jc->getSetting(SettingID::STICK_POWER));
+				float remappedLeanAngle = jc->getStickPowerCurve()(clamp((absLeanAngle - motionDZInner) / (180.f - motionDZOuter - motionDZInner), 0.f, 1.f));
 
 				// now actually convert to output stick value, taking deadzones and power curve into account
-				float undeadzoneInner, undeadzoneOuter, unpower;
-				if (isLeft)
-				{
-					undeadzoneInner = jc->getSetting(SettingID::LEFT_STICK_UNDEADZONE_INNER);
-					undeadzoneOuter = jc->getSetting(SettingID::LEFT_STICK_UNDEADZONE_OUTER);
-					unpower = jc->getSetting(SettingID::LEFT_STICK_UNPOWER);
-				}
-				else
+				const StickResponse &response = jc->getVirtualStickResponse(isLeft);
+				if (response.livezoneSize() > 0.f)
 				{
-					undeadzoneInner = jc->getSetting(SettingID::RIGHT_STICK_UNDEADZONE_INNER);
-					undeadzoneOuter = jc->getSetting(SettingID::RIGHT_STICK_UNDEADZONE_OUTER);
-					unpower = jc->getSetting(SettingID::RIGHT_STICK_UNPOWER);
-				}
-
-				float livezoneSize = 1.f - undeadzoneOuter - undeadzoneInner;
-				if (livezoneSize > 0.f)
-				{
-					// unpower curve
-					if (unpower != 0.f)
-					{
-						remappedLeanAngle = pow(remappedLeanAngle, 1.f / unpower);
-					}
-
-					if (remappedLeanAngle < 1.f)
-					{
-						remappedLeanAngle = undeadzoneInner + remappedLeanAngle * livezoneSize;
-					}
+					remappedLeanAngle = response.remap(remappedLeanAngle);
 
 					float signedStickValue = leanSign * remappedLeanAngle;
 					// COUT << "LEAN ANGLE: " << (leanSign * absLeanAngle) << "    REMAPPED: " << (leanSign * remappedLeanAngle) << "     STICK OUT: " << signedStickValue << '\n';
@@ -1084,11 +935,7 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 		  rightEffect.mode == AdaptiveTriggerMode::ON ? jc->_rightEffect : rightEffect);
 	}
 
-	bool currentMicToggleState = find_if(jc->_context->activeTogglesQueue.cbegin(), jc->_context->activeTogglesQueue.cend(),
-	                               [](const auto &pair)
-	                               {
-		                               return pair.first == ButtonID::MIC;
-	                               }) != jc->_context->activeTogglesQueue.cend();
+	bool currentMicToggleState = jc->_context->activeToggles.contains(ButtonID::MIC);
 	for (auto controller : handle_to_joyshock)
 	{
 		jsl->SetMicLight(controller.first, currentMicToggleState ? 1 : 0);
@@ -1141,8 +988,44 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 	jc->_context->callback_lock.unlock();
 }
 
+// Remember the current gyro offsets of all connected devices for the next time they connect
+void storeCalibrations()
+{
+	if (!calibrationCache)
+		return;
+	for (auto &[handle, jc] : handle_to_joyshock)
+	{
+		JSM::CalibrationCache::Offset offset;
+		{
+			lock_guard guard(jc->_context->callback_lock);
+			jc->_motion->GetCalibrationOffset(offset.x, offset.y, offset.z);
+		}
+		if (!jc->_deviceId.empty() && (offset.x != 0.f || offset.y != 0.f || offset.z != 0.f))
+		{
+			calibrationCache->set(jc->_deviceId, offset);
+		}
+	}
+	calibrationCache->save();
+}
+
+// Called from the cache loading thread
+void restoreCalibrations(vector<shared_ptr<JoyShock>> joyshocks)
+{
+	for (auto &jc : joyshocks)
+	{
+		auto offset = jc->_deviceId.empty() ? nullopt : calibrationCache->get(jc->_deviceId);
+		if (offset)
+		{
+			lock_guard guard(jc->_context->callback_lock);
+			jc->_motion->SetCalibrationOffset(offset->x, offset->y, offset->z, JSM::CalibrationCache::RESTORED_WEIGHT);
+			DEBUG_LOG << "Restored gyro calibration of controller " << jc->_handle << '\n';
+		}
+	}
+}
+
 void connectDevices(bool mergeJoycons = true)
 {
+	storeCalibrations();
 	handle_to_joyshock.clear();
 	this_thread::sleep_for(100ms);
 	int numConnected = jsl->ConnectDevices();
@@ -1179,6 +1062,14 @@ void connectDevices(bool mergeJoycons = true)
 		}
 	}
 
+	if (calibrationCache && !handle_to_joyshock.empty())
+	{
+		vector<shared_ptr<JoyShock>> joyshocks;
+		for (auto &[handle, jc] : handle_to_joyshock)
+			joyshocks.push_back(jc);
+		calibrationCache->loadAsync(bind(&restoreCalibrations, joyshocks));
+	}
+
 	if (numConnected == 1)
 	{
 		COUT << "1 device connected\n";
@@ -1359,6 +1250,7 @@ bool do_FINISH_GYRO_CALIBRATION()
 		iter->second->_motion->PauseContinuousCalibration();
 	}
 	devicesCalibrating = false;
+	storeCalibrations();
 	return true;
 }
 
@@ -1384,6 +1276,48 @@ bool do_SET_MOTION_STICK_NEUTRAL()
 	return true;
 }
 
+bool do_CALIBRATE_TRIGGERS(string_view argument)
+{
+	shared_ptr<JoyShock> target;
+	if (argument.length() > 0)
+	{
+		try
+		{
+			auto device = handle_to_joyshock.find(stoi(string(argument)));
+			if (device != handle_to_joyshock.end())
+				target = device->second;
+		}
+		catch (const exception &)
+		{
+			COUT << "Can't convert \"" << argument << "\" to a device number\n";
+			return false;
+		}
+	}
+	else
+	{
+		auto device = find_if(handle_to_joyshock.begin(), handle_to_joyshock.end(), [](auto &entry)
+		  { return entry.second->_controllerType == JS_TYPE_DS; });
+		if (device != handle_to_joyshock.end())
+			target = device->second;
+	}
+	if (!target || target->_controllerType != JS_TYPE_DS)
+	{
+		COUT << "No dualsense to calibrate\n";
+		return false;
+	}
+	return triggerCalibration->start(target);
+}
+
+bool do_REPLAY_BUTTONS(string_view argument)
+{
+	if (argument.empty())
+	{
+		COUT << "Enter the path of a button recording to replay\n";
+		return false;
+	}
+	return JSM::replayButtons(string(argument));
+}
+
 bool do_SLEEP(string_view argument)
 {
 	// first, check for a parameter
@@ -1550,6 +1484,7 @@ void cleanUp()
 		tray->Hide();
 	}
 	HideConsole();
+	storeCalibrations();
 	jsl->DisconnectAndDisposeAll();
 	handle_to_joyshock.clear(); // Destroy Vigem Gamepads
 	ReleaseConsole();
@@ -1751,6 +1686,33 @@ void updateRingModeFromStickMode(JSMVariable<RingMode> *stickRingMode, const Sti
 	}
 }
 
+void onMotionEngineChange(const MotionEngine &newEngine)
+{
+	for (auto &js : handle_to_joyshock)
+	{
+		lock_guard guard(js.second->_context->callback_lock);
+		// Carry over the calibration so that switching doesn't require calibrating again
+		float x, y, z;
+		js.second->_motion->GetCalibrationOffset(x, y, z);
+		shared_ptr<MotionIf> newMotion(MotionIf::getNew(newEngine));
+		newMotion->SetCalibrationOffset(x, y, z, JSM::CalibrationCache::RESTORED_WEIGHT);
+		if (js.second->_motion->IsCalibrating())
+		{
+			// A calibration in progress goes on from the offset so far
+			newMotion->StartContinuousCalibration();
+		}
+		if (js.second->_context->rightMainMotion == js.second->_motion)
+		{
+			js.second->_context->rightMainMotion = newMotion;
+		}
+		else if (js.second->_context->leftMotion == js.second->_motion)
+		{
+			js.second->_context->leftMotion = newMotion;
+		}
+		js.second->_motion = newMotion;
+	}
+}
+
 ControllerScheme updateVirtualController(ControllerScheme prevScheme, ControllerScheme nextScheme)
 {
 	string error;
@@ -2032,7 +1994,9 @@ private:
 			{
 				auto pos = cmd.find(arg);
 				if (pos != string::npos)
+				{
 					COUT_INFO << "    " << cmd << '\n';
+				}
 			}
 			COUT << "Enter HELP [cmd1] [cmd2] ... for details on specific commands.\n";
 		}
@@ -2175,6 +2139,11 @@ void initJsmSettings(CmdRegistry *commandRegistry)
 	commandRegistry->add((new JSMAssignment<float>(*max_gyro_threshold))
 	                       ->setHelp("Degrees per second at and above which to apply maximum gyro sensitivity."));
 
+	auto gyro_sens_curve = new JSMSetting<GyroSensCurve>(SettingID::GYRO_SENS_CURVE, GyroSensCurve());
+	SettingsManager::add(gyro_sens_curve);
+	commandRegistry->add((new JSMAssignment<GyroSensCurve>(*gyro_sens_curve))
+	                       ->setHelp("Custom gyro acceleration curve as pairs of degrees per second and sensitivity, such as 0 1 20 2 75 4. Sensitivity is interpolated between the points and replaces MIN_GYRO_SENS, MAX_GYRO_SENS and their thresholds. Set to NONE to go back to those."));
+
 	auto stick_power = new JSMSetting<float>(SettingID::STICK_POWER, 1.0f);
 	stick_power->setFilter(&filterFloat);
 	SettingsManager::add(stick_power);
@@ -2283,6 +2252,18 @@ void initJsmSettings(CmdRegistry *commandRegistry)
 	commandRegistry->add((new JSMAssignment<float>(*gyro_smooth_threshold))
 	                       ->setHelp("When the controller's angular velocity is below this threshold (in degrees per second), smoothing will be applied."));
 
+	auto gyro_prediction_time = new JSMSetting<float>(SettingID::GYRO_PREDICTION_TIME, 0.0f);
+	gyro_prediction_time->setFilter(&filterPositive);
+	SettingsManager::add(gyro_prediction_time);
+	commandRegistry->add((new JSMAssignment<float>(*gyro_prediction_time))
+	                       ->setHelp("How far ahead in seconds to extrapolate gyro velocity to compensate for input latency and smoothing. A few milliseconds such as 0.008 is plenty. 0 disables prediction."));
+
+	auto gyro_prediction_cap = new JSMSetting<float>(SettingID::GYRO_PREDICTION_CAP, 30.0f);
+	gyro_prediction_cap->setFilter(&filterPositive);
+	SettingsManager::add(gyro_prediction_cap);
+	commandRegistry->add((new JSMAssignment<float>(*gyro_prediction_cap))
+	                       ->setHelp("Largest change in degrees per second that gyro prediction may add on each axis. Prediction never reverses the direction of motion."));
+
 	auto gyro_cutoff_speed = new JSMSetting<float>(SettingID::GYRO_CUTOFF_SPEED, 0.0f);
 	gyro_cutoff_speed->setFilter(&filterPositive);
 	SettingsManager::add(gyro_cutoff_speed);
@@ -2459,6 +2440,29 @@ void initJsmSettings(CmdRegistry *commandRegistry)
 	commandRegistry->add((new JSMAssignment<float>("TICK_TIME", *tick_time))
 	                       ->setHelp("Sets the time in milliseconds that JoyShockMaper waits before reading from each controller again."));
 
+	auto idle_tick_time = new JSMVariable<float>(100.f);
+	idle_tick_time->setFilter(&filterPositive);
+	SettingsManager::add(SettingID::IDLE_TICK_TIME, idle_tick_time);
+	commandRegistry->add((new JSMAssignment<float>(magic_enum::enum_name(SettingID::IDLE_TICK_TIME).data(), *idle_tick_time))
+	                       ->setHelp("Sets the time in milliseconds between two full updates of a controller that is held still and not being used.\n"
+	                                 "Any input brings the controller back to TICK_TIME right away. Set to 0 to always process controllers at full rate."));
+
+	auto flick_output_rate = new JSMVariable<float>(0.f);
+	triggerCalibration.reset(new JSM::TriggerCalibration(jsl));
+	flickOutput.reset(new JSM::FlickOutput(flick_output_rate->value(), flick_output_rate->value() > 0.f));
+	flick_output_rate->setFilter(&filterPositive)->addOnChangeListener([](float rate)
+	  {
+		  flickOutput->setRate(rate);
+		  if (rate > 0.f)
+			  flickOutput->Start();
+		  else
+			  flickOutput->Stop();
+	  });
+	SettingsManager::add(SettingID::FLICK_OUTPUT_RATE, flick_output_rate);
+	commandRegistry->add((new JSMAssignment<float>(magic_enum::enum_name(SettingID::FLICK_OUTPUT_RATE).data(), *flick_output_rate))
+	                       ->setHelp("Sets the rate in Hz at which flick stick rotation is sent to the mouse, independently of TICK_TIME. Up to 1000.\n"
+	                                 "Only used when both FLICK_STICK_OUTPUT and GYRO_OUTPUT are MOUSE. Set to 0 to move the mouse on each controller update."));
+
 	auto light_bar = new JSMSetting<Color>(SettingID::LIGHT_BAR, 0xFFFFFF);
 	// light_bar needs no filter or listener. The callback polls and updates the color.
 	SettingsManager::add(light_bar);
@@ -2471,6 +2475,13 @@ void initJsmSettings(CmdRegistry *commandRegistry)
 	commandRegistry->add((new JSMAssignment<FloatXY>(*scroll_sens))
 	                       ->setHelp("Scrolling sensitivity for sticks."));
 
+	auto hires_scroll = new JSMSetting<Switch>(SettingID::HIRES_SCROLL, Switch::OFF);
+	hires_scroll->setFilter(&filterInvalidValue<Switch, Switch::INVALID>);
+	SettingsManager::add(hires_scroll);
+	commandRegistry->add((new JSMAssignment<Switch>(*hires_scroll))
+	                       ->setHelp("When ON, SCROLL_WHEEL sticks scroll the mouse wheel smoothly instead of pulsing their left and right bindings.\n"
+	                                 "Rotating SCROLL_SENS degrees counter-clockwise scrolls up by one notch. Valid values are ON and OFF."));
+
 	auto autoloadSwitch = new JSMVariable<Switch>(Switch::ON);
 	autoLoadThread.reset(new JSM::AutoLoad(commandRegistry, autoloadSwitch->value() == Switch::ON)); // Start by default
 	autoloadSwitch->setFilter(&filterInvalidValue<Switch, Switch::INVALID>)->addOnChangeListener(bind(&updateThread, autoLoadThread.get(), placeholders::_1));
@@ -2749,8 +2760,14 @@ void initJsmSettings(CmdRegistry *commandRegistry)
 	commandRegistry->add((new JSMAssignment<float>(*return_deadzone_cutoff_angle))
 	    ->setHelp("In HYBRID_AIM stick mode, angle to the center in which the return deadzone is fully active.\n"\
 			      "Valid values range from 0 to 90"));
-		
 
+	auto motion_engine = new JSMVariable<MotionEngine>(MotionEngine::GAMEPAD_MOTION);
+	motion_engine->setFilter(&filterInvalidValue<MotionEngine, MotionEngine::INVALID>);
+	motion_engine->addOnChangeListener(&onMotionEngineChange);
+	SettingsManager::add(SettingID::MOTION_ENGINE, motion_engine);
+	commandRegistry->add((new JSMAssignment<MotionEngine>(magic_enum::enum_name(SettingID::MOTION_ENGINE).data(), *motion_engine))
+	                       ->setHelp("Sensor fusion used to compute gravity from the gyro and accelerometer. GAMEPAD_MOTION (default) is the most accurate.\n"
+	                                 "COMPLEMENTARY is a cheaper gravity only filter, suited for low power devices and the LOCAL gyro space."));
 }
 
 #ifdef _WIN32
@@ -2875,11 +2892,8 @@ int main(int argc, char *argv[])
 	commandRegistry.add((new JSMMacro("WHITELIST_REMOVE"))->SetMacro(bind(&do_WHITELIST_REMOVE))->setHelp("Remove JoyShockMapper from whitelisted applications."));
 	commandRegistry.add(new HelpCmd(commandRegistry));
 	commandRegistry.add((new JSMMacro("CLEAR"))->SetMacro(bind(&ClearConsole))->setHelp("Removes all text in the console screen"));
-	commandRegistry.add((new JSMMacro("CALIBRATE_TRIGGERS"))->SetMacro([](JSMMacro *, string_view)
-	                                                          {
-		                                                        triggerCalibrationStep = 1;
-		                                                        return true; })
-	                      ->setHelp("Starts the trigger calibration procedure for the dualsense triggers."));
+	commandRegistry.add((new JSMMacro("CALIBRATE_TRIGGERS"))->SetMacro(bind(&do_CALIBRATE_TRIGGERS, placeholders::_2))->setHelp("Starts the trigger calibration procedure for the dualsense triggers. Optionally enter the device number to calibrate, otherwise the first dualsense is calibrated. The results are assigned to the trigger offset and range settings."));
+	commandRegistry.add((new JSMMacro("REPLAY_BUTTONS"))->SetMacro(bind(&do_REPLAY_BUTTONS, placeholders::_2))->setHelp("Replay the button changes recorded in the given file with the current bindings and settings, and print every key, gyro, rumble and command output instead of performing it. Each line of the file is \"<ms> <BUTTON> <1|0>\"."));
 	bool quit = false;
 	commandRegistry.add((new JSMMacro("QUIT"))
 	                      ->SetMacro([&quit](JSMMacro *, string_view)
@@ -2891,6 +2905,7 @@ int main(int argc, char *argv[])
 
 	Mapping::_isCommandValid = bind(&CmdRegistry::isCommandValid, &commandRegistry, placeholders::_1);
 
+	calibrationCache.reset(new JSM::CalibrationCache("GyroCalibrations.cache"));
 	connectDevices();
 	jsl->SetCallback(&joyShockPollCallback);
 	jsl->SetTouchCallback(&touchCallback);
@@ -1,6 +1,7 @@
 #include "JoyShockMapper.h"
 #include "JslWrapper.h"
 #include "ColorCodes.h"
+#include "PlatformDefinitions.h"
 
 #include <cstring>
 #include <sstream>
@@ -8,6 +9,7 @@
 #include <algorithm>
 #include <iomanip>
 #include <cmath>
+#include <mutex>
 
 static optional<float> getFloat(const string &str, size_t *newpos = nullptr)
 {
@@ -38,15 +40,19 @@ istream &operator>>(istream &in, ButtonID &rhv)
 	return in;
 }
 
-ostream &operator<<(ostream &out, const ButtonID &rhv)
+string_view buttonName(ButtonID id)
 {
-	if (rhv == ButtonID::PLUS)
-		out << "+";
-	else if (rhv == ButtonID::MINUS)
-		out << "-";
+	if (id == ButtonID::PLUS)
+		return "+";
+	else if (id == ButtonID::MINUS)
+		return "-";
 	else
-		out << magic_enum::enum_name(rhv);
-	return out;
+		return magic_enum::enum_name(id);
+}
+
+ostream &operator<<(ostream &out, const ButtonID &rhv)
+{
+	return out << buttonName(rhv);
 }
 
 istream &operator>>(istream &in, FlickSnapMode &fsm)
@@ -162,6 +168,75 @@ bool operator==(const GyroSettings &lhs, const GyroSettings &rhs)
 	  lhs.ignore_mode == rhs.ignore_mode;
 }
 
+GyroSensCurve::GyroSensCurve(vector<FloatXY> points)
+{
+	if (points.empty())
+		return;
+
+	stable_sort(points.begin(), points.end(), [](const FloatXY &lhs, const FloatXY &rhs)
+	  { return lhs.x() < rhs.x(); });
+	_points = make_shared<const vector<FloatXY>>(move(points));
+}
+
+const vector<FloatXY> &GyroSensCurve::points() const
+{
+	static const vector<FloatXY> noPoints;
+	return _points ? *_points : noPoints;
+}
+
+istream &operator>>(istream &in, GyroSensCurve &curve)
+{
+	string value;
+	getline(in, value);
+	stringstream ss(value);
+	string first;
+	if (ss >> first && first == "NONE")
+	{
+		curve = GyroSensCurve();
+		return in;
+	}
+	ss.clear();
+	ss.seekg(0);
+
+	vector<FloatXY> points;
+	float speed, sens;
+	while (ss >> speed)
+	{
+		if (!(ss >> sens) || !isfinite(speed) || !isfinite(sens) || speed < 0.f)
+		{
+			in.setstate(in.failbit);
+			return in;
+		}
+		points.emplace_back(speed, sens);
+	}
+	if (points.empty() || !(ss >> ws).eof())
+	{
+		in.setstate(in.failbit);
+		return in;
+	}
+	curve = GyroSensCurve(move(points));
+	return in;
+}
+
+ostream &operator<<(ostream &out, const GyroSensCurve &curve)
+{
+	if (curve.empty())
+		return out << "NONE";
+
+	const char *separator = "";
+	for (auto &point : curve.points())
+	{
+		out << separator << point.x() << ' ' << point.y();
+		separator = " ";
+	}
+	return out;
+}
+
+bool operator==(const GyroSensCurve &lhs, const GyroSensCurve &rhs)
+{
+	return lhs.points() == rhs.points();
+}
+
 ostream &operator<<(ostream &out, const FloatXY &fxy)
 {
 	out << fxy.first;
@@ -402,4 +477,100 @@ bool operator==(const AdaptiveTriggerSetting &lhs, const AdaptiveTriggerSetting
 		lhs.frequency == rhs.frequency &&
 		lhs.forceExtra == rhs.forceExtra &&
 		lhs.frequencyExtra == rhs.frequencyExtra;
-}
\ No newline at end of file
+}
+
+// Names are added but never removed, in chunks that never move: a name can be read without
+// locking by anyone holding its id.
+class KeyNameTable
+{
+public:
+	static constexpr size_t CHUNK_SIZE = 256;
+
+	KeyNameTable()
+	{
+		intern("None");
+	}
+
+	optional<uint16_t> intern(string_view name)
+	{
+		lock_guard guard(_lock);
+		auto found = _ids.find(name);
+		if (found != _ids.end())
+		{
+			return found->second;
+		}
+		if (_count == CHUNK_SIZE * _chunks.size())
+		{
+			return nullopt;
+		}
+		uint16_t id = uint16_t(_count++);
+		auto &chunk = _chunks[id / CHUNK_SIZE];
+		if (!chunk)
+		{
+			chunk = make_unique<string[]>(CHUNK_SIZE);
+		}
+		chunk[id % CHUNK_SIZE] = name;
+		_ids.emplace(name, id);
+		return id;
+	}
+
+	string_view name(uint16_t id) const
+	{
+		return _chunks[id / CHUNK_SIZE][id % CHUNK_SIZE];
+	}
+
+private:
+	mutex _lock;
+	map<string, uint16_t, less<>> _ids;
+	array<unique_ptr<string[]>, 0x10000 / CHUNK_SIZE> _chunks;
+	size_t _count = 0;
+};
+
+static KeyNameTable &keyNames()
+{
+	static KeyNameTable table;
+	return table;
+}
+
+optional<uint16_t> KeyCode::intern(string_view name)
+{
+	return keyNames().intern(name);
+}
+
+string_view KeyCode::name() const
+{
+	return keyNames().name(nameId);
+}
+
+KeyCode::KeyCode(string_view keyName)
+  : code(nameToKey(keyName))
+{
+	if (code == COMMAND_ACTION)
+		setName(keyName.substr(1, keyName.size() - 2)); // Remove opening and closing quotation marks
+	else if (keyName.compare("SMALL_RUMBLE") == 0)
+	{
+		code = RUMBLE;
+		setName(SMALL_RUMBLE);
+	}
+	else if (keyName.compare("BIG_RUMBLE") == 0)
+	{
+		code = RUMBLE;
+		setName(BIG_RUMBLE);
+	}
+	else
+		setName(code != 0 ? keyName : "");
+}
+
+void KeyCode::setName(string_view keyName)
+{
+	if (auto id = intern(keyName))
+	{
+		nameId = *id;
+	}
+	else
+	{
+		CERR << "Too many different key names: \"" << keyName << "\" can't be bound\n";
+		code = 0;
+		nameId = 0;
+	}
+}
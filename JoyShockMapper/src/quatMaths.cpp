@@ -230,4 +230,36 @@ struct Vec
 		  z * other.x - x * other.z,
 		  x * other.y - y * other.x);
 	}
-};
\ No newline at end of file
+};
+
+// The rotation of a unit quaternion as a 3x3 matrix, for rotating many vectors by the same quaternion.
+// Vec * RotationMatrix(q) gives the same result as Vec * q for a fraction of the cost.
+struct RotationMatrix
+{
+	float m[3][3];
+
+	RotationMatrix()
+	  : RotationMatrix(Quat())
+	{
+	}
+
+	RotationMatrix(const Quat& q)
+	{
+		m[0][0] = 1.0f - 2.0f * (q.y * q.y + q.z * q.z);
+		m[0][1] = 2.0f * (q.x * q.y - q.w * q.z);
+		m[0][2] = 2.0f * (q.x * q.z + q.w * q.y);
+		m[1][0] = 2.0f * (q.x * q.y + q.w * q.z);
+		m[1][1] = 1.0f - 2.0f * (q.x * q.x + q.z * q.z);
+		m[1][2] = 2.0f * (q.y * q.z - q.w * q.x);
+		m[2][0] = 2.0f * (q.x * q.z - q.w * q.y);
+		m[2][1] = 2.0f * (q.y * q.z + q.w * q.x);
+		m[2][2] = 1.0f - 2.0f * (q.x * q.x + q.y * q.y);
+	}
+
+	friend Vec operator*(const Vec& lhs, const RotationMatrix& rhs)
+	{
+		return Vec(rhs.m[0][0] * lhs.x + rhs.m[0][1] * lhs.y + rhs.m[0][2] * lhs.z,
+		  rhs.m[1][0] * lhs.x + rhs.m[1][1] * lhs.y + rhs.m[1][2] * lhs.z,
+		  rhs.m[2][0] * lhs.x + rhs.m[2][1] * lhs.y + rhs.m[2][2] * lhs.z);
+	}
+};
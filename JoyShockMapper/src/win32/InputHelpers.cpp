@@ -1,10 +1,12 @@
 #include "InputHelpers.h"
 #include <thread>
+#include <mutex>
 
 #include <unordered_map>
 
 static float accumulatedX = 0;
 static float accumulatedY = 0;
+static mutex accumulatedLock; // the flick output thread moves the mouse too
 
 // Windows' mouse speed settings translate non-linearly to speed.
 // Thankfully, the mappings are available here: https://liquipedia.net/counterstrike/Mouse_settings#Windows_Sensitivity
@@ -71,7 +73,7 @@ int pressMouse(KeyCode vkKey, bool isPressed)
 	if (input.mi.dwFlags)
 	{ // Ignore if there's no event ID (ex: "wheel release")
 		auto result = SendInput(1, &input, sizeof(input));
-		//COUT << key.name << '\n';
+		//COUT << key.name() << '\n';
 		//COUT << key.key << '\n';
 		return result;
 	}
@@ -145,6 +147,7 @@ int pressKey(KeyCode vkKey, bool pressed)
 
 void moveMouse(float x, float y)
 {
+	lock_guard guard(accumulatedLock);
 	accumulatedX += x;
 	accumulatedY += y;
 
@@ -165,6 +168,24 @@ void moveMouse(float x, float y)
 	SendInput(1, &input, sizeof(input));
 }
 
+static float accumulatedScroll = 0;
+
+void scrollMouse(float notches)
+{
+	lock_guard guard(accumulatedLock);
+	accumulatedScroll += notches * WHEEL_DELTA;
+	int applicableScroll = (int)accumulatedScroll;
+	accumulatedScroll -= applicableScroll;
+	if (applicableScroll == 0)
+		return;
+
+	INPUT input{};
+	input.type = INPUT_MOUSE;
+	input.mi.mouseData = applicableScroll;
+	input.mi.dwFlags = MOUSEEVENTF_WHEEL;
+	SendInput(1, &input, sizeof(input));
+}
+
 void setMouseNorm(float x, float y)
 {
 	INPUT input;
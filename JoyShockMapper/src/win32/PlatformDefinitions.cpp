@@ -7,43 +7,37 @@
 constexpr uint16_t DEFAULT_COLOR = FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE; // White
 #define FOREGROUND_YELLOW FOREGROUND_RED | FOREGROUND_GREEN
 
-template<ostream *stdio, uint16_t color>
-class ColorStream : public stringbuf
+static void printColor(ostream &stdio, uint16_t color, string_view text)
 {
-public:
-	ColorStream() { }
-	// print the string on the stdio
-	virtual ~ColorStream()
-	{
-		lock_guard<mutex> guard(print_mutex);
-		HANDLE hStdout = GetStdHandle(STD_ERROR_HANDLE);
-		SetConsoleTextAttribute(hStdout, color);
-		(*stdio) << str();
-		SetConsoleTextAttribute(hStdout, DEFAULT_COLOR);
-	}
-};
+	lock_guard<mutex> guard(print_mutex);
+	HANDLE hStdout = GetStdHandle(STD_ERROR_HANDLE);
+	SetConsoleTextAttribute(hStdout, color);
+	stdio << text;
+	SetConsoleTextAttribute(hStdout, DEFAULT_COLOR);
+}
 
-streambuf *Log::makeBuffer(Level level)
+void Log::print(Level level, string_view text)
 {
 	switch (level)
 	{
 	case Level::ERR:
-		return new ColorStream<&cerr, FOREGROUND_RED | FOREGROUND_INTENSITY>();
+		printColor(cerr, FOREGROUND_RED | FOREGROUND_INTENSITY, text);
+		break;
 	case Level::WARN:
-		return new ColorStream<&cout, FOREGROUND_YELLOW | FOREGROUND_INTENSITY>();
+		printColor(cout, FOREGROUND_YELLOW | FOREGROUND_INTENSITY, text);
+		break;
 	case Level::INFO:
-		return new ColorStream<&cout, FOREGROUND_BLUE | FOREGROUND_INTENSITY>();
-#if defined(NDEBUG) // release
-	case Level::UT:
-		return new NullBuffer(); // unused
-#else
+		printColor(cout, FOREGROUND_BLUE | FOREGROUND_INTENSITY, text);
+		break;
 	case Level::UT:
-		return new ColorStream<&cout, FOREGROUND_BLUE | FOREGROUND_RED>(); // purplish
-#endif
+		printColor(cout, FOREGROUND_BLUE | FOREGROUND_RED, text); // purplish
+		break;
 	case Level::BOLD:
-		return new ColorStream<&cout, FOREGROUND_GREEN | FOREGROUND_INTENSITY>();
+		printColor(cout, FOREGROUND_GREEN | FOREGROUND_INTENSITY, text);
+		break;
 	default:
-		return new ColorStream<&cout, FOREGROUND_GREEN>();
+		printColor(cout, FOREGROUND_GREEN, text);
+		break;
 	}
 }
 
@@ -64,7 +58,7 @@ const char *BASE_JSM_CONFIG_FOLDER()
 
 std::ostream &operator<<(std::ostream &out, const KeyCode &code)
 {
-	return out << code.name;
+	return out << code.name();
 }
 
 /// Valid inputs: